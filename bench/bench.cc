@@ -0,0 +1,67 @@
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+#include "bench.hh"
+
+using namespace std;
+
+namespace bench {
+  volatile uint64_t sink = 0;
+
+  static atomic<uint64_t> allocation_count( 0 );
+  static string name_filter;
+
+  uint64_t allocations()
+  {
+    return allocation_count.load( memory_order_relaxed );
+  }
+
+  void set_filter( const string & filter )
+  {
+    name_filter = filter;
+  }
+
+  bool selected( const string & name )
+  {
+    return name.find( name_filter ) != string::npos;
+  }
+
+  void report( const string & name, const string & param,
+	       const uint64_t operations, const uint64_t elapsed_ns,
+	       const uint64_t allocated )
+  {
+    cout << "{\"name\": \"" << name << "\", \"param\": \"" << param << "\""
+	 << ", \"operations\": " << operations
+	 << ", \"ns_per_op\": " << double( elapsed_ns ) / operations
+	 << ", \"allocs_per_op\": " << double( allocated ) / operations
+	 << "}" << endl;
+  }
+}
+
+/* count every heap allocation in the process */
+void * operator new( size_t size )
+{
+  bench::allocation_count.fetch_add( 1, memory_order_relaxed );
+  void * const ret = malloc( size ? size : 1 );
+  if ( not ret ) {
+    throw bad_alloc();
+  }
+  return ret;
+}
+
+void * operator new[]( size_t size )
+{
+  return operator new( size );
+}
+
+void operator delete( void * ptr ) noexcept
+{
+  free( ptr );
+}
+
+void operator delete[]( void * ptr ) noexcept
+{
+  free( ptr );
+}
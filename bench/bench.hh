@@ -0,0 +1,63 @@
+#ifndef BENCH_HH
+#define BENCH_HH
+
+#include <cstdint>
+#include <string>
+
+#include "timestamp.hh"
+
+/* Minimal benchmark harness: times an operation, counts the heap
+   allocations it makes, and prints one JSON object per result. */
+
+namespace bench {
+  /* heap allocations made by this process so far */
+  uint64_t allocations();
+
+  /* only run benchmarks whose name contains this (empty: run all) */
+  void set_filter( const std::string & filter );
+  bool selected( const std::string & name );
+
+  /* print a result */
+  void report( const std::string & name, const std::string & param,
+	       const uint64_t operations, const uint64_t elapsed_ns,
+	       const uint64_t allocations );
+
+  /* keeps the optimizer from discarding results */
+  extern volatile uint64_t sink;
+
+  /* time op() until at least MIN_TIME_NS has elapsed;
+     each call counts as ops_per_call operations */
+  static const uint64_t MIN_TIME_NS = 200000000;
+
+  template <typename Operation>
+  void run( const std::string & name, const std::string & param,
+	    const Operation & op, const unsigned int ops_per_call = 1 )
+  {
+    if ( not selected( name ) ) {
+      return;
+    }
+
+    /* warm up (caches, lazily allocated buffers) */
+    for ( unsigned int i = 0; i < 16; i++ ) {
+      op();
+    }
+
+    uint64_t calls = 0, elapsed = 0, allocated = 0;
+    uint64_t batch = 1;
+    while ( elapsed < MIN_TIME_NS ) {
+      const uint64_t allocations_before = allocations();
+      const uint64_t start = timestamp_ns();
+      for ( uint64_t i = 0; i < batch; i++ ) {
+	op();
+      }
+      elapsed += timestamp_ns() - start;
+      allocated += allocations() - allocations_before;
+      calls += batch;
+      batch *= 2;
+    }
+
+    report( name, param, calls * ops_per_call, elapsed, allocated );
+  }
+}
+
+#endif /* BENCH_HH */
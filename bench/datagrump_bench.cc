@@ -0,0 +1,302 @@
+/* microbenchmarks for the datagram hot path */
+
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+
+#include "bench.hh"
+#include "byte_stream.hh"
+#include "contest_message.hh"
+#include "controller.hh"
+#include "io_uring.hh"
+#include "poller.hh"
+#include "socket.hh"
+#include "util.hh"
+
+using namespace std;
+using namespace PollerShortNames;
+
+/* a data datagram as the sender puts it on the wire */
+static string make_datagram()
+{
+  ContestMessage message( 42, string( 1424, 'x' ) );
+  message.set_send_timestamp();
+  return message.to_string();
+}
+
+static void bench_contest_message()
+{
+  const string datagram = make_datagram();
+  char buffer[ ContestMessage::Header::WIRE_SIZE ];
+
+  bench::run( "contest_message/parse_header", "", [&] () {
+      const ContestMessage::Header header( datagram.data(), datagram.size() );
+      bench::sink = header.send_timestamp;
+    } );
+
+  bench::run( "contest_message/parse_message", "", [&] () {
+      const ContestMessage message( datagram );
+      bench::sink = message.payload.size();
+    } );
+
+  const ContestMessage::Header header( datagram );
+
+  bench::run( "contest_message/serialize_header", "", [&] () {
+      header.serialize( buffer );
+      bench::sink = buffer[ 0 ];
+    } );
+
+  const ContestMessage message( datagram );
+
+  bench::run( "contest_message/serialize_message", "", [&] () {
+      bench::sink = message.to_string().size();
+    } );
+
+  /* the receiver's in-place path */
+  string ack_buffer = datagram;
+  uint64_t sequence_number = 0;
+
+  bench::run( "contest_message/transform_into_ack_in_place", "", [&] () {
+      ContestMessage::Header ack( &ack_buffer[ 0 ], ack_buffer.size() );
+      ack.transform_into_ack( sequence_number++, 1000,
+			      ack_buffer.size() - ContestMessage::Header::WIRE_SIZE );
+      ack.serialize( &ack_buffer[ 0 ] );
+    } );
+
+  bench::run( "contest_message/transform_into_ack", "", [&] () {
+      ContestMessage ack( datagram );
+      ack.transform_into_ack( sequence_number++, 1000 );
+      bench::sink = ack.to_string().size();
+    } );
+}
+
+static void bench_udp_socket()
+{
+  UDPSocket receiver, sender;
+  receiver.set_timestamps();
+  receiver.bind( Address( "127.0.0.1", uint16_t( 0 ) ) );
+  sender.connect( receiver.local_address() );
+
+  const string datagram = make_datagram();
+
+  bench::run( "udp_socket/send_recv", "1472", [&] () {
+      sender.send( datagram );
+      bench::sink = receiver.recv().payload.size();
+    } );
+
+  PacketPool pool;
+
+  bench::run( "udp_socket/send_recv_pooled", "1472", [&] () {
+      sender.send( datagram );
+      bench::sink = receiver.recv( pool ).length;
+    } );
+
+  const vector<string> batch( UDPSocket::BATCH_SIZE, datagram );
+  vector<UDPSocket::received_datagram> received;
+
+  bench::run( "udp_socket/send_batch_recv_batch", "1472", [&] () {
+      sender.send_batch( batch );
+      size_t count = 0;
+      while ( count < batch.size() ) {
+	count += receiver.recv_batch( received );
+      }
+      bench::sink = count;
+    }, UDPSocket::BATCH_SIZE );
+
+  vector<UDPSocket::received_view> views;
+
+  bench::run( "udp_socket/send_batch_recv_batch_in_place", "1472", [&] () {
+      sender.send_batch( batch );
+      size_t count = 0;
+      while ( count < batch.size() ) {
+	count += receiver.recv_batch( views );
+      }
+      bench::sink = count;
+    }, UDPSocket::BATCH_SIZE );
+
+  /* the same, with segmentation and receive offload (where the kernel has them) */
+  UDPSocket gro_receiver, gso_sender;
+  gro_receiver.set_timestamps();
+  gro_receiver.bind( Address( "127.0.0.1", uint16_t( 0 ) ) );
+  gso_sender.connect( gro_receiver.local_address() );
+
+  if ( gro_receiver.set_gro() and gso_sender.set_gso() ) {
+    string segments;
+    for ( const auto & payload : batch ) {
+      segments += payload;
+    }
+
+    bench::run( "udp_socket/send_segments_recv_batch", "1472", [&] () {
+	gso_sender.send_segments( segments.data(), datagram.size(), batch.size() );
+	size_t count = 0;
+	while ( count < batch.size() ) {
+	  count += gro_receiver.recv_batch( received );
+	}
+	bench::sink = count;
+      }, UDPSocket::BATCH_SIZE );
+  }
+
+  /* the same through io_uring: sends from registered buffers, a multishot receive */
+  if ( IOUring::supported() ) {
+    IOUring ring;
+    size_t delivered = 0;
+    ring.recv_multishot( receiver, [&] ( UDPSocket::received_datagram & ) { delivered++; } );
+
+    bench::run( "io_uring/send_recv_multishot", "1472", [&] () {
+	for ( const auto & payload : batch ) {
+	  ring.send( sender, payload.data(), payload.size() );
+	}
+	const size_t target = delivered + batch.size();
+	while ( delivered < target ) {
+	  ring.wait();
+	}
+      }, UDPSocket::BATCH_SIZE );
+  }
+}
+
+static void bench_poller( const unsigned int action_count )
+{
+  /* one eventfd per action; only one of them is ever ready */
+  vector< unique_ptr<FileDescriptor> > fds;
+  Poller poller;
+
+  const string one( reinterpret_cast<const char *>( "\1\0\0\0\0\0\0\0" ), 8 );
+
+  for ( unsigned int i = 0; i < action_count; i++ ) {
+    fds.emplace_back( new FileDescriptor( SystemCall( "eventfd", eventfd( 0, EFD_NONBLOCK ) ) ) );
+    FileDescriptor & fd = *fds.back();
+    poller.add_action( Action( fd, Direction::In, [&fd] () {
+	  bench::sink = fd.read( 8 ).size();
+	  return ResultType::Continue;
+	} ) );
+  }
+
+  FileDescriptor & ready = *fds.back();
+
+  bench::run( "poller/poll_one_ready", to_string( action_count ), [&] () {
+      ready.write( one );
+      poller.poll( 0 );
+    } );
+}
+
+static void bench_byte_stream()
+{
+  /* 64 small writes through a local socket pair, read back out */
+  int fds[ 2 ];
+  SystemCall( "socketpair", socketpair( AF_UNIX, SOCK_STREAM, 0, fds ) );
+  FileDescriptor sender( fds[ 0 ] ), receiver( fds[ 1 ] );
+
+  const string piece( 256, 'x' );
+  const size_t total = 64 * piece.size();
+  vector<char> buffer( total );
+
+  bench::run( "byte_stream/fd_write_read", "64x256", [&] () {
+      for ( unsigned int i = 0; i < 64; i++ ) {
+	sender.write( piece );
+      }
+      size_t count = 0;
+      while ( count < total ) {
+	count += receiver.read( total - count ).size();
+      }
+      bench::sink = count;
+    }, 64 );
+
+  ByteStream output( sender ), input( receiver );
+
+  bench::run( "byte_stream/write_flush_fill_read_into", "64x256", [&] () {
+      for ( unsigned int i = 0; i < 64; i++ ) {
+	output.write( piece );
+      }
+      while ( output.queued() ) {
+	output.flush();
+      }
+      size_t count = 0;
+      while ( count < total ) {
+	input.fill();
+	count += input.read_into( &buffer[ count ], total - count );
+      }
+      bench::sink = count;
+    }, 64 );
+}
+
+static void bench_nonblocking()
+{
+  /* polling an empty socket: the error as a result, against as an exception */
+  UDPSocket socket;
+  socket.bind( Address( "127.0.0.1", uint16_t( 0 ) ) );
+  socket.set_blocking( false );
+  PacketPool pool( 2048 );
+
+  bench::run( "nonblocking/try_recv_empty", "udp", [&] () {
+      bench::sink = socket.try_recv( pool ).would_block();
+    } );
+
+  bench::run( "nonblocking/recv_empty_catch", "udp", [&] () {
+      try {
+	bench::sink = socket.recv( pool ).length;
+      } catch ( const unix_error & e ) {
+	bench::sink = e.code().value() == EAGAIN;
+      }
+    } );
+}
+
+static void bench_controller( const string & algorithm, const unsigned int window )
+{
+  /* acks arrive evenly over the controller's RTT window (two RTTs),
+     spaced so that about `window` samples are in it at once */
+  const uint64_t rtt = 40000;
+  const uint64_t spacing = max( uint64_t( 1 ), 2 * rtt / window );
+
+  const unique_ptr<Controller> controller = Controller::make( algorithm, false );
+  uint64_t now = rtt, sequence_number = 0;
+
+  auto ack = [&] () {
+    controller->ack_received( sequence_number++, now - rtt, now - rtt / 2, now );
+    now += spacing;
+  };
+
+  for ( unsigned int i = 0; i < 2 * window; i++ ) {
+    ack();
+  }
+
+  bench::run( "controller/ack_received", algorithm + "/" + to_string( window ), ack );
+}
+
+int main( int argc, char *argv[] )
+{
+  if ( argc < 1 ) { /* for sticklers */
+    abort();
+  }
+
+  if ( argc > 2 ) {
+    cerr << "Usage: " << argv[ 0 ] << " [NAME-FILTER]" << endl;
+    return EXIT_FAILURE;
+  }
+
+  if ( argc == 2 ) {
+    bench::set_filter( argv[ 1 ] );
+  }
+
+  bench_contest_message();
+  bench_udp_socket();
+
+  bench_byte_stream();
+
+  bench_nonblocking();
+
+  for ( const unsigned int actions : { 1, 10, 100, 1000 } ) {
+    bench_poller( actions );
+  }
+
+  for ( const auto & algorithm : Controller::names() ) {
+    for ( const unsigned int window : { 16, 256, 4096, 65536 } ) {
+      bench_controller( algorithm, window );
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
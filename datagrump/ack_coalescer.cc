@@ -0,0 +1,185 @@
+#include <limits>
+#include <algorithm>
+#include <iterator>
+
+#include "ack_coalescer.hh"
+#include "timestamp.hh"
+
+using namespace std;
+
+AckCoalescer::Source::Source( const Address & s_address )
+  : address( s_address ),
+    highest_sequence_number( 0 ),
+    seen(),
+    pending( 0 ),
+    first_pending_us( 0 ),
+    newest_sequence_number( 0 ),
+    newest_send_timestamp( 0 ),
+    newest_payload_length( 0 ),
+    bitmap( 0 ),
+    recv_timestamps()
+{}
+
+AckCoalescer::AckCoalescer( UDPSocket & socket,
+			    const unsigned int max_datagrams,
+			    const uint64_t max_delay_us )
+  : socket_( socket ),
+    max_datagrams_( max( 1u, min( max_datagrams, CoalescedAck::MAX_DATAGRAMS ) ) ),
+    max_delay_us_( max_delay_us ),
+    sequence_number_( 0 ),
+    sources_(),
+    ack_( ContestMessage::Header::WIRE_SIZE + sizeof( CoalescedAck ) )
+{}
+
+/* find (or start tracking) a source; there are only ever a few */
+AckCoalescer::Source & AckCoalescer::source( const Address & address )
+{
+  for ( auto & s : sources_ ) {
+    if ( s.address == address ) {
+      return s;
+    }
+  }
+
+  sources_.emplace_back( address );
+  return sources_.back();
+}
+
+/* remember that a datagram arrived */
+void AckCoalescer::mark_arrived( Source & s, const uint64_t sequence_number )
+{
+  const uint64_t HISTORY = CoalescedAck::HISTORY;
+
+  /* forget what falls out of the history as it moves up */
+  if ( sequence_number > s.highest_sequence_number ) {
+    if ( sequence_number - s.highest_sequence_number >= HISTORY ) {
+      fill( begin( s.seen ), end( s.seen ), 0 );
+    } else {
+      for ( uint64_t i = s.highest_sequence_number + 1; i <= sequence_number; i++ ) {
+	s.seen[ (i % HISTORY) / 64 ] &= ~(uint64_t( 1 ) << (i % 64));
+      }
+    }
+    s.highest_sequence_number = sequence_number;
+  }
+
+  if ( s.highest_sequence_number - sequence_number < HISTORY ) {
+    s.seen[ (sequence_number % HISTORY) / 64 ] |= uint64_t( 1 ) << (sequence_number % 64);
+  }
+}
+
+/* has a datagram arrived? (false if too old to know) */
+bool AckCoalescer::has_arrived( const Source & s, const uint64_t sequence_number ) const
+{
+  const uint64_t HISTORY = CoalescedAck::HISTORY;
+
+  return sequence_number <= s.highest_sequence_number
+    and s.highest_sequence_number - sequence_number < HISTORY
+    and (s.seen[ (sequence_number % HISTORY) / 64 ] & (uint64_t( 1 ) << (sequence_number % 64)));
+}
+
+void AckCoalescer::received( const UDPSocket::received_view & datagram )
+{
+  const ContestMessage::Header header( datagram.payload, datagram.length );
+  const uint64_t sequence_number = header.sequence_number;
+  Source & s = source( *datagram.source_address );
+
+  /* a datagram the bitmap can't reach, or one that would shift
+     waiting datagrams out of it, starts a new ack */
+  if ( s.pending ) {
+    const uint64_t distance = sequence_number > s.newest_sequence_number
+      ? sequence_number - s.newest_sequence_number
+      : s.newest_sequence_number - sequence_number;
+    if ( distance >= CoalescedAck::MAX_DATAGRAMS
+	 or (sequence_number > s.newest_sequence_number
+	     and (s.bitmap >> (CoalescedAck::MAX_DATAGRAMS - distance))) ) {
+      flush( s );
+    } else if ( sequence_number <= s.newest_sequence_number
+		and (s.bitmap & (uint64_t( 1 ) << distance)) ) {
+      return; /* duplicate of a waiting datagram */
+    }
+  }
+
+  /* (after any flush, so the ack carrying its receive time is the first to cover it) */
+  mark_arrived( s, sequence_number );
+
+  if ( s.pending == 0 ) {
+    s.first_pending_us = timestamp_us();
+    s.bitmap = 0;
+    s.newest_sequence_number = sequence_number;
+  }
+
+  if ( sequence_number >= s.newest_sequence_number ) {
+    s.bitmap = (s.bitmap << (sequence_number - s.newest_sequence_number)) | 1;
+    s.newest_sequence_number = sequence_number;
+    s.newest_send_timestamp = header.send_timestamp;
+    s.newest_payload_length = datagram.length - ContestMessage::Header::WIRE_SIZE;
+  } else {
+    s.bitmap |= uint64_t( 1 ) << (s.newest_sequence_number - sequence_number);
+  }
+
+  s.recv_timestamps[ sequence_number % CoalescedAck::MAX_DATAGRAMS ] = datagram.timestamp;
+  s.pending++;
+
+  if ( s.pending >= max_datagrams_ ) {
+    flush( s );
+  }
+}
+
+/* send one ack covering every waiting datagram from a source */
+void AckCoalescer::flush( Source & s )
+{
+  const uint64_t newest_recv_timestamp
+    = s.recv_timestamps[ s.newest_sequence_number % CoalescedAck::MAX_DATAGRAMS ];
+
+  /* the header acknowledges the newest datagram, as a plain ack would */
+  ContestMessage::Header header( s.newest_sequence_number );
+  header.send_timestamp = s.newest_send_timestamp;
+  header.transform_into_ack( sequence_number_++, newest_recv_timestamp,
+			     s.newest_payload_length );
+
+  /* the trailer covers the rest, and repeats recent arrivals */
+  CoalescedAck trailer;
+  for ( uint64_t i = 0; i < CoalescedAck::HISTORY and i <= s.newest_sequence_number; i++ ) {
+    if ( has_arrived( s, s.newest_sequence_number - i ) ) {
+      trailer.arrived[ i / 64 ] |= uint64_t( 1 ) << (i % 64);
+    }
+  }
+  trailer.bitmap = s.bitmap;
+  for ( unsigned int i = 0; i < CoalescedAck::MAX_DATAGRAMS; i++ ) {
+    if ( s.bitmap & (uint64_t( 1 ) << i) ) {
+      const uint64_t sequence_number = s.newest_sequence_number - i;
+      trailer.recv_offsets[ i ] = int32_t( newest_recv_timestamp
+	- s.recv_timestamps[ sequence_number % CoalescedAck::MAX_DATAGRAMS ] );
+    }
+  }
+
+  /* timestamp the ack just before sending */
+  header.set_send_timestamp();
+  header.serialize( ack_.data() );
+  trailer.serialize( ack_.data() + ContestMessage::Header::WIRE_SIZE );
+
+  socket_.sendto( s.address, ack_.data(),
+		  ContestMessage::Header::WIRE_SIZE + trailer.wire_size() );
+
+  s.pending = 0;
+}
+
+void AckCoalescer::flush_expired( const uint64_t now_us )
+{
+  for ( auto & s : sources_ ) {
+    if ( s.pending and now_us >= s.first_pending_us + max_delay_us_ ) {
+      flush( s );
+    }
+  }
+}
+
+uint64_t AckCoalescer::next_deadline() const
+{
+  uint64_t deadline = numeric_limits<uint64_t>::max();
+  for ( const auto & s : sources_ ) {
+    if ( s.pending ) {
+      deadline = min( deadline, s.first_pending_us + max_delay_us_ );
+    }
+  }
+
+  return deadline;
+}
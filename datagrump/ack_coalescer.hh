@@ -0,0 +1,78 @@
+#ifndef ACK_COALESCER_HH
+#define ACK_COALESCER_HH
+
+#include <cstdint>
+#include <vector>
+
+#include "socket.hh"
+#include "contest_message.hh"
+
+/* Acknowledges datagrams in groups rather than one at a time. An ack goes
+   out once max_datagrams datagrams from a source are waiting for one, or
+   the oldest of them has waited max_delay_us. Each ack is a header for the
+   newest datagram followed by a CoalescedAck trailer covering the rest,
+   which also repeats what has arrived recently in case an ack is lost. */
+
+class AckCoalescer
+{
+private:
+  struct Source
+  {
+    Address address;
+
+    /* the highest sequence number seen, and which of the HISTORY
+       sequence numbers up to it have arrived (bit sequence_number % HISTORY) */
+    uint64_t highest_sequence_number;
+    uint64_t seen[ CoalescedAck::HISTORY / 64 ];
+
+    /* datagrams waiting for an ack, and when the first of them arrived */
+    unsigned int pending;
+    uint64_t first_pending_us;
+
+    /* the newest waiting datagram */
+    uint64_t newest_sequence_number;
+    uint64_t newest_send_timestamp;
+    uint64_t newest_payload_length;
+
+    /* bit i set: datagram (newest_sequence_number - i) is waiting */
+    uint64_t bitmap;
+
+    /* receive timestamps of waiting datagrams, by sequence number modulo 64 */
+    uint64_t recv_timestamps[ CoalescedAck::MAX_DATAGRAMS ];
+
+    Source( const Address & s_address );
+  };
+
+  UDPSocket & socket_;
+  unsigned int max_datagrams_;
+  uint64_t max_delay_us_;
+
+  /* acks are numbered per coalescer */
+  uint64_t sequence_number_;
+
+  std::vector<Source> sources_;
+
+  /* wire representation of the outgoing ack */
+  std::vector<char> ack_;
+
+  Source & source( const Address & address );
+  void mark_arrived( Source & source, const uint64_t sequence_number );
+  bool has_arrived( const Source & source, const uint64_t sequence_number ) const;
+  void flush( Source & source );
+
+public:
+  AckCoalescer( UDPSocket & socket,
+		const unsigned int max_datagrams,
+		const uint64_t max_delay_us );
+
+  /* note an incoming datagram, sending an ack if one is now due */
+  void received( const UDPSocket::received_view & datagram );
+
+  /* send the acks whose delay has run out */
+  void flush_expired( const uint64_t now_us );
+
+  /* when the next ack falls due (UINT64_MAX if none is waiting) */
+  uint64_t next_deadline() const;
+};
+
+#endif /* ACK_COALESCER_HH */
@@ -0,0 +1,73 @@
+#include <algorithm>
+
+#include "aimd_controller.hh"
+#include "event_log.hh"
+
+using namespace std;
+
+AIMDController::AIMDController( const bool debug )
+  : Controller( debug ),
+    window_( INITIAL_WINDOW ),
+    srtt_us_( 0 ),
+    next_sequence_number_( 0 ),
+    recovery_end_( 0 )
+{}
+
+unsigned int AIMDController::window_size()
+{
+  return window_;
+}
+
+void AIMDController::datagram_was_sent( const uint64_t sequence_number,
+					const uint64_t send_timestamp,
+					const bool after_timeout )
+{
+  next_sequence_number_ = max( next_sequence_number_, sequence_number + 1 );
+
+  if ( after_timeout ) {
+    decrease( sequence_number, send_timestamp, true );
+  }
+}
+
+void AIMDController::packet_lost( const uint64_t sequence_number,
+				  const uint64_t send_timestamp )
+{
+  decrease( sequence_number, send_timestamp, false );
+}
+
+/* multiplicative decrease, once per window */
+void AIMDController::decrease( const uint64_t sequence_number,
+			       const uint64_t timestamp,
+			       const bool after_timeout )
+{
+  if ( sequence_number < recovery_end_ ) {
+    return;
+  }
+
+  window_ = max( 1.0, window_ / 2 );
+  recovery_end_ = next_sequence_number_;
+
+  EventLog::log( EventLog::Type::WindowCut, timestamp, flow_id_, after_timeout, sequence_number,
+		 window_ );
+}
+
+void AIMDController::ack_received( const uint64_t sequence_number_acked,
+				   const uint64_t send_timestamp_acked,
+				   const uint64_t,
+				   const uint64_t timestamp_ack_received )
+{
+  const double rtt = timestamp_ack_received - send_timestamp_acked;
+  srtt_us_ = srtt_us_ > 0 ? 0.875 * srtt_us_ + 0.125 * rtt : rtt;
+
+  /* additive increase: one datagram per window of acks */
+  window_ += 1 / window_;
+
+  EventLog::log( EventLog::Type::RttSample, timestamp_ack_received, flow_id_, 0, sequence_number_acked,
+		 rtt, srtt_us_, 0, 0, window_ );
+}
+
+unsigned int AIMDController::timeout_us()
+{
+  /* wait a second for the first RTT sample, then twice the smoothed RTT */
+  return srtt_us_ > 0 ? max( 2 * srtt_us_, 20000.0 ) : 1000000;
+}
@@ -0,0 +1,45 @@
+#ifndef AIMD_CONTROLLER_HH
+#define AIMD_CONTROLLER_HH
+
+#include <cstdint>
+
+#include "controller.hh"
+
+/* TCP-style additive increase, multiplicative decrease: the window
+   grows by one datagram per window of acks and halves (at most once
+   per window) when a datagram is lost or a timeout suggests one was */
+
+class AIMDController : public Controller
+{
+private:
+  double window_; /* in datagrams */
+  double srtt_us_; /* smoothed RTT (0 until the first sample) */
+
+  /* one past the newest datagram sent */
+  uint64_t next_sequence_number_;
+
+  /* no further decrease until the datagrams sent before the
+     last one have had their chance to be acknowledged */
+  uint64_t recovery_end_;
+
+  void decrease( const uint64_t sequence_number, const uint64_t timestamp, const bool after_timeout );
+
+public:
+  static constexpr double INITIAL_WINDOW = 10;
+
+  AIMDController( const bool debug );
+
+  unsigned int window_size() override;
+  void datagram_was_sent( const uint64_t sequence_number,
+			  const uint64_t send_timestamp,
+			  const bool after_timeout ) override;
+  void ack_received( const uint64_t sequence_number_acked,
+		     const uint64_t send_timestamp_acked,
+		     const uint64_t recv_timestamp_acked,
+		     const uint64_t timestamp_ack_received ) override;
+  void packet_lost( const uint64_t sequence_number,
+		    const uint64_t send_timestamp ) override;
+  unsigned int timeout_us() override;
+};
+
+#endif /* AIMD_CONTROLLER_HH */
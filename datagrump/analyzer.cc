@@ -0,0 +1,438 @@
+/* score a contest run from mahimahi's uplink log (mm-link --uplink-log),
+   as mm-throughput-graph does, without leaving the machine */
+
+#include <algorithm>
+#include <cstring>
+#include <endian.h>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "link_stats.hh"
+#include "mmap_file.hh"
+#include "util.hh"
+
+using namespace std;
+
+static const uint64_t NEVER = numeric_limits<uint64_t>::max();
+
+/* most threads=N allows */
+static const unsigned int MAX_THREADS = 1024;
+
+namespace {
+  /* traffic in one window of the log */
+  struct Window
+  {
+    uint64_t capacity_bytes, arrival_bytes, departure_bytes;
+    uint64_t max_delay_ms;
+  };
+
+  /* everything learned from one stretch of the log. Accumulators for
+     consecutive stretches merge into the accumulator for the whole. */
+  class LogStats
+  {
+  private:
+    const uint64_t base_ms_;
+    const uint64_t window_ms_;
+
+    /* time since the link started, or the first event (anything earlier
+       counts as at the start) */
+    uint64_t since_base( const uint64_t timestamp_ms ) const
+    {
+      return timestamp_ms > base_ms_ ? timestamp_ms - base_ms_ : 0;
+    }
+
+    Window & window( const uint64_t timestamp_ms )
+    {
+      const uint64_t index = since_base( timestamp_ms ) / window_ms_;
+      if ( index >= windows.size() ) {
+	windows.resize( max( index + 1, 2 * windows.size() ), Window() );
+      }
+      return windows[ index ];
+    }
+
+  public:
+    uint64_t first_ms, last_ms;
+    uint64_t capacity_bytes, departure_bytes;
+    uint64_t dropped_packets;
+    uint64_t unparsed_lines;
+    vector<uint64_t> delay_counts; /* departures by their delay, in ms */
+    SignalDelay signal_delay;
+    vector<Window> windows;
+
+    LogStats( const uint64_t base_ms, const uint64_t window_ms )
+      : base_ms_( base_ms ), window_ms_( window_ms ),
+	first_ms( NEVER ), last_ms( 0 ), capacity_bytes( 0 ), departure_bytes( 0 ),
+	dropped_packets( 0 ), unparsed_lines( 0 ), delay_counts(), signal_delay(), windows()
+    {}
+
+    void event( const uint64_t timestamp_ms )
+    {
+      first_ms = min( first_ms, timestamp_ms );
+      last_ms = max( last_ms, timestamp_ms );
+    }
+
+    void opportunity( const uint64_t timestamp_ms, const uint64_t bytes )
+    {
+      capacity_bytes += bytes;
+      window( timestamp_ms ).capacity_bytes += bytes;
+    }
+
+    void arrival( const uint64_t timestamp_ms, const uint64_t bytes )
+    {
+      window( timestamp_ms ).arrival_bytes += bytes;
+    }
+
+    void departure( const uint64_t timestamp_ms, const uint64_t bytes, const uint64_t delay_ms )
+    {
+      departure_bytes += bytes;
+
+      if ( delay_ms >= delay_counts.size() ) {
+	delay_counts.resize( delay_ms + 1, 0 );
+      }
+      delay_counts[ delay_ms ]++;
+
+      const uint64_t delivered_ms = since_base( timestamp_ms );
+      signal_delay.add( (delivered_ms - min( delivered_ms, delay_ms )) * 1000, delivered_ms * 1000 );
+
+      Window & w = window( timestamp_ms );
+      w.departure_bytes += bytes;
+      w.max_delay_ms = max( w.max_delay_ms, delay_ms );
+    }
+
+    void merge( const LogStats & other )
+    {
+      first_ms = min( first_ms, other.first_ms );
+      last_ms = max( last_ms, other.last_ms );
+      capacity_bytes += other.capacity_bytes;
+      departure_bytes += other.departure_bytes;
+      dropped_packets += other.dropped_packets;
+      unparsed_lines += other.unparsed_lines;
+
+      delay_counts.resize( max( delay_counts.size(), other.delay_counts.size() ), 0 );
+      for ( size_t i = 0; i < other.delay_counts.size(); i++ ) {
+	delay_counts[ i ] += other.delay_counts[ i ];
+      }
+
+      signal_delay.merge( other.signal_delay );
+
+      windows.resize( max( windows.size(), other.windows.size() ), Window() );
+      for ( size_t i = 0; i < other.windows.size(); i++ ) {
+	windows[ i ].capacity_bytes += other.windows[ i ].capacity_bytes;
+	windows[ i ].arrival_bytes += other.windows[ i ].arrival_bytes;
+	windows[ i ].departure_bytes += other.windows[ i ].departure_bytes;
+	windows[ i ].max_delay_ms = max( windows[ i ].max_delay_ms, other.windows[ i ].max_delay_ms );
+      }
+    }
+
+    /* 95th percentile per-packet delay, from the histogram */
+    uint64_t delay_p95_ms() const
+    {
+      uint64_t total = 0;
+      for ( const auto & count : delay_counts ) {
+	total += count;
+      }
+
+      const uint64_t rank = (total * 95 + 99) / 100;
+      uint64_t seen = 0;
+      for ( size_t i = 0; i < delay_counts.size(); i++ ) {
+	seen += delay_counts[ i ];
+	if ( seen >= rank and seen > 0 ) {
+	  return i;
+	}
+      }
+      return 0;
+    }
+  };
+
+  /* if the eight bytes at p are all ASCII digits, their value (most
+     significant first), found a word at a time; otherwise false.
+     (Timestamps are 13 digits long, and a digit at a time they would
+     dominate the running time.) */
+  bool parse_eight_digits( const char * const p, uint64_t & value )
+  {
+    uint64_t chunk;
+    memcpy( &chunk, p, sizeof( chunk ) );
+    chunk = le64toh( chunk ); /* first digit in the low byte */
+
+    /* every byte must be 0x30-0x39 */
+    const uint64_t high_nibbles = chunk & 0xF0F0F0F0F0F0F0F0;
+    const uint64_t over_nine = ((chunk + 0x0606060606060606) & 0xF0F0F0F0F0F0F0F0) >> 4;
+    if ( (high_nibbles | over_nine) != 0x3333333333333333 ) {
+      return false;
+    }
+
+    /* combine pairs of digits, then pairs of pairs, then the two halves */
+    chunk -= 0x3030303030303030;
+    chunk = (chunk * 10) + (chunk >> 8);
+    value = (((chunk & 0x000000FF000000FF) * (100 + (1000000ULL << 32)))
+	     + (((chunk >> 16) & 0x000000FF000000FF) * (1 + (10000ULL << 32)))) >> 32;
+    return true;
+  }
+
+  /* read an unsigned decimal number, advancing p; false if there isn't one */
+  bool parse_number( const char * & p, const char * const end, uint64_t & value )
+  {
+    if ( p == end or *p < '0' or *p > '9' ) {
+      return false;
+    }
+
+    value = 0;
+    uint64_t eight;
+    while ( end - p >= 8 and parse_eight_digits( p, eight ) ) {
+      value = value * 100000000 + eight;
+      p += 8;
+    }
+
+    while ( p != end and *p >= '0' and *p <= '9' ) {
+      value = value * 10 + (*p - '0');
+      p++;
+    }
+    return true;
+  }
+
+  bool parse_space( const char * & p, const char * const end )
+  {
+    if ( p == end or *p != ' ' ) {
+      return false;
+    }
+    p++;
+    return true;
+  }
+
+  /* one event line: "TIME # BYTES" (delivery opportunity), "TIME + BYTES"
+     (arrival), "TIME - BYTES DELAY" (departure) or "TIME d COUNT BYTES" (drop).
+     Stops after the fields, which is usually at the end of the line. */
+  bool parse_line( const char * & p, const char * const end, LogStats & stats )
+  {
+    uint64_t timestamp, first, second;
+    if ( not parse_number( p, end, timestamp ) or not parse_space( p, end ) or p == end ) {
+      return false;
+    }
+
+    const char type = *p++;
+    if ( not parse_space( p, end ) or not parse_number( p, end, first ) ) {
+      return false;
+    }
+
+    switch ( type ) {
+    case '#':
+      stats.opportunity( timestamp, first );
+      break;
+    case '+':
+      stats.arrival( timestamp, first );
+      break;
+    case '-':
+      if ( not parse_space( p, end ) or not parse_number( p, end, second ) ) {
+	return false;
+      }
+      stats.departure( timestamp, first, second );
+      break;
+    case 'd':
+      stats.dropped_packets += first;
+      break;
+    default:
+      return false;
+    }
+
+    stats.event( timestamp );
+    return true;
+  }
+
+  /* analyze the lines that start within [begin, end) */
+  void analyze( const char * begin, const char * const end, const char * const file_end,
+		LogStats & stats )
+  {
+    while ( begin < end ) {
+      const char * p = begin;
+
+      /* comments and blank lines aside, parse the line in one pass */
+      if ( *p != '#' and *p != '\n' and not parse_line( p, file_end, stats ) ) {
+	stats.unparsed_lines++;
+      }
+
+      /* and find where the next one starts (only searching if something follows the fields) */
+      if ( p == file_end or *p != '\n' ) {
+	p = static_cast<const char *>( memchr( p, '\n', file_end - p ) );
+	if ( not p ) {
+	  return;
+	}
+      }
+
+      begin = p + 1;
+    }
+  }
+
+  /* the "# base timestamp: N" line from the log's header (0 if missing) */
+  uint64_t base_timestamp( const char * p, const char * const end )
+  {
+    const string tag = "# base timestamp: ";
+
+    while ( p < end and *p == '#' ) {
+      const char * newline = static_cast<const char *>( memchr( p, '\n', end - p ) );
+      if ( not newline ) {
+	newline = end;
+      }
+
+      uint64_t value;
+      const char * number = p + tag.size();
+      if ( size_t( newline - p ) > tag.size() and equal( tag.begin(), tag.end(), p )
+	   and parse_number( number, newline, value ) ) {
+	return value;
+      }
+
+      p = newline + 1;
+    }
+
+    return 0;
+  }
+
+  /* the timestamp of the log's first event (0 if it has none) */
+  uint64_t first_timestamp( const char * p, const char * const end )
+  {
+    while ( p < end ) {
+      uint64_t value;
+      const char * number = p;
+      if ( *p != '#' and parse_number( number, end, value ) ) {
+	return value;
+      }
+
+      p = static_cast<const char *>( memchr( p, '\n', end - p ) );
+      if ( not p ) {
+	return 0;
+      }
+      p++;
+    }
+
+    return 0;
+  }
+}
+
+int main( int argc, char *argv[] )
+{
+   /* check the command-line arguments */
+  if ( argc < 1 ) { /* for sticklers */
+    abort();
+  }
+
+  if ( argc < 2 ) {
+    cerr << "Usage: " << argv[ 0 ] << " UPLINK-LOG [window=MS] [series=FILE] [threads=N]" << endl
+	 << "(series=FILE writes per-window capacity, throughput and delay as CSV)" << endl;
+    return EXIT_FAILURE;
+  }
+
+  uint64_t window_ms = 500;
+  string series_filename;
+  unsigned int thread_count = max( 1u, thread::hardware_concurrency() );
+
+  for ( int i = 2; i < argc; i++ ) {
+    const string arg = argv[ i ];
+    const string::size_type equals = arg.find( '=' );
+    const string key = arg.substr( 0, equals );
+    const string value = equals == string::npos ? "" : arg.substr( equals + 1 );
+
+    bool valid = true;
+
+    if ( key == "window" ) {
+      valid = parse_number( value, window_ms, uint64_t( 1 ) );
+    } else if ( key == "series" and not value.empty() ) {
+      series_filename = value;
+    } else if ( key == "threads" ) {
+      valid = parse_number( value, thread_count, 1u, MAX_THREADS );
+    } else {
+      valid = false;
+    }
+
+    if ( not valid ) {
+      cerr << "Unknown or invalid option: " << arg << endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  const MappedFile log( argv[ 1 ] );
+  const char * const begin = log.data(), * const end = log.data() + log.size();
+
+  /* Times are kept relative to the link's start, or, if the header
+     doesn't say when that was, to the first event (which every thread
+     must agree on, so find it first) */
+  const uint64_t header_base_ms = base_timestamp( begin, end );
+  const uint64_t base_ms = header_base_ms ? header_base_ms : first_timestamp( begin, end );
+
+  /* each thread takes the lines starting in one slice of the file */
+  vector<LogStats> stats( thread_count, LogStats( base_ms, window_ms ) );
+  vector<thread> threads;
+  for ( unsigned int i = 0; i < thread_count; i++ ) {
+    const char * const slice_begin = begin + log.size() * i / thread_count;
+    const char * const slice_end = begin + log.size() * (i + 1) / thread_count;
+    threads.emplace_back( [&, i, slice_begin, slice_end] () {
+	/* a line belongs to the slice it starts in */
+	const char * start = slice_begin;
+	if ( i > 0 ) {
+	  while ( start < slice_end and start[ -1 ] != '\n' ) {
+	    start++;
+	  }
+	}
+	analyze( start, slice_end, end, stats[ i ] );
+      } );
+  }
+
+  for ( auto & t : threads ) {
+    t.join();
+  }
+
+  for ( unsigned int i = 1; i < thread_count; i++ ) {
+    stats[ 0 ].merge( stats[ i ] );
+  }
+  const LogStats & total = stats[ 0 ];
+
+  if ( total.unparsed_lines ) {
+    cerr << "Warning: skipped " << total.unparsed_lines << " unrecognized lines" << endl;
+  }
+
+  if ( total.first_ms == NEVER ) {
+    cerr << argv[ 1 ] << ": no events in log" << endl;
+    return EXIT_FAILURE;
+  }
+
+  /* the run lasted from the link's start (or the first event) to the last event */
+  const double duration_ms = max( base_ms + 1, total.last_ms ) - base_ms;
+  const double capacity = total.capacity_bytes * 8 / duration_ms / 1000;
+  const double throughput = total.departure_bytes * 8 / duration_ms / 1000;
+  const double signal_delay = total.signal_delay.p95_ms();
+
+  cout << fixed << setprecision( 2 );
+  cout << "Average capacity: " << capacity << " Mbits/s" << endl;
+  cout << "Average throughput: " << throughput << " Mbits/s ("
+       << (capacity > 0 ? 100 * throughput / capacity : 0) << "% utilization)" << endl;
+  cout << "95th percentile per-packet queueing delay: " << total.delay_p95_ms() << " ms" << endl;
+  cout << "95th percentile signal delay: " << signal_delay << " ms" << endl;
+  cout << "Power score: " << (signal_delay > 0 ? throughput / (signal_delay / 1000) : 0)
+       << " (Mbits/s)/s" << endl;
+  cout << "Datagrams dropped: " << total.dropped_packets << endl;
+
+  if ( not series_filename.empty() ) {
+    ofstream series( series_filename );
+    if ( not series.is_open() ) {
+      cerr << "could not open " << series_filename << endl;
+      return EXIT_FAILURE;
+    }
+
+    series << fixed << setprecision( 3 );
+    series << "time_s,capacity_mbps,offered_mbps,throughput_mbps,max_delay_ms\n";
+    const uint64_t last_window = (max( base_ms, total.last_ms ) - base_ms) / window_ms;
+    for ( uint64_t i = 0; i <= last_window and i < total.windows.size(); i++ ) {
+      const Window & w = total.windows[ i ];
+      const double scale = 8.0 / window_ms / 1000; /* bytes per window to Mbits/s */
+      series << i * window_ms / 1000.0 << "," << w.capacity_bytes * scale
+	     << "," << w.arrival_bytes * scale << "," << w.departure_bytes * scale
+	     << "," << w.max_delay_ms << "\n";
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
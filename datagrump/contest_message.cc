@@ -1,4 +1,7 @@
 #include <stdexcept>
+#include <cstring>
+
+#include <endian.h>
 
 #include "contest_message.hh"
 #include "timestamp.hh"
@@ -6,79 +9,107 @@
 using namespace std;
 
 /* helper to get the nth uint64_t field (in network byte order) */
-uint64_t get_header_field( const size_t n, const string & str )
+static uint64_t get_header_field( const size_t n, const char * const data, const size_t length )
 {
-  if ( str.size() < (n + 1) * sizeof( uint64_t ) ) {
+  if ( length < (n + 1) * sizeof( uint64_t ) ) {
     throw runtime_error( "contest message too small to contain header" );
   }
 
-  const uint64_t * const data_ptr
-    = reinterpret_cast<const uint64_t *>( str.data() ) + n;
+  uint64_t network_order;
+  memcpy( &network_order, data + n * sizeof( uint64_t ), sizeof( network_order ) );
+
+  return be64toh( network_order );
+}
 
-  return be64toh( *data_ptr );
+/* helper to put the nth uint64_t field (in network byte order) */
+static void put_header_field( const size_t n, const uint64_t value, char * const data )
+{
+  const uint64_t network_order = htobe64( value );
+  memcpy( data + n * sizeof( uint64_t ), &network_order, sizeof( network_order ) );
 }
 
+/* Parse header in place from a caller-owned buffer */
+ContestMessage::Header::Header( const char * const data, const size_t length )
+  : sequence_number( get_header_field( 0, data, length ) ),
+    send_timestamp( get_header_field( 1, data, length ) ),
+    ack_sequence_number( get_header_field( 2, data, length ) ),
+    ack_send_timestamp( get_header_field( 3, data, length ) ),
+    ack_recv_timestamp( get_header_field( 4, data, length ) ),
+    ack_payload_length( get_header_field( 5, data, length ) )
+{}
+
 /* Parse header from wire */
 ContestMessage::Header::Header( const string & str )
-  : sequence_number( get_header_field( 0, str ) ),
-    send_timestamp( get_header_field( 1, str ) ),
-    ack_sequence_number( get_header_field( 2, str ) ),
-    ack_send_timestamp( get_header_field( 3, str ) ),
-    ack_recv_timestamp( get_header_field( 4, str ) ),
-    ack_payload_length( get_header_field( 5, str ) )
+  : Header( str.data(), str.size() )
 {}
 
 /* Parse incoming message from wire */
 ContestMessage::ContestMessage( const string & str )
   : header( str ),
-    payload( str.begin() + sizeof( header ), str.end() )
+    payload( str.begin() + Header::WIRE_SIZE, str.end() )
 {}
 
 /* Fill in the send_timestamp for an outgoing message */
+void ContestMessage::Header::set_send_timestamp()
+{
+  send_timestamp = timestamp_us();
+}
+
 void ContestMessage::set_send_timestamp()
 {
-  header.send_timestamp = timestamp_ms();
+  header.set_send_timestamp();
 }
 
-/* helper to put a uint64_t field (in network byte order) */
-string put_header_field( const uint64_t n )
+/* Write wire representation of header into a caller-owned buffer */
+void ContestMessage::Header::serialize( char * const data ) const
 {
-  const uint64_t network_order = htobe64( n );
-  return string( reinterpret_cast<const char *>( &network_order ),
-		 sizeof( network_order ) );
+  put_header_field( 0, sequence_number, data );
+  put_header_field( 1, send_timestamp, data );
+  put_header_field( 2, ack_sequence_number, data );
+  put_header_field( 3, ack_send_timestamp, data );
+  put_header_field( 4, ack_recv_timestamp, data );
+  put_header_field( 5, ack_payload_length, data );
 }
 
 /* Make wire representation of header */
 string ContestMessage::Header::to_string() const
 {
-  return put_header_field( sequence_number )
-    + put_header_field( send_timestamp )
-    + put_header_field( ack_sequence_number )
-    + put_header_field( ack_send_timestamp )
-    + put_header_field( ack_recv_timestamp )
-    + put_header_field( ack_payload_length );
+  string ret( WIRE_SIZE, 0 );
+  serialize( &ret[ 0 ] );
+  return ret;
 }
 
 /* Make wire representation of message */
 string ContestMessage::to_string() const
 {
-  return header.to_string() + payload;
+  string ret( Header::WIRE_SIZE + payload.size(), 0 );
+  header.serialize( &ret[ 0 ] );
+  payload.copy( &ret[ Header::WIRE_SIZE ], payload.size() );
+  return ret;
 }
 
-/* Transform into an ack of the ContestMessage */
-void ContestMessage::transform_into_ack( const uint64_t sequence_number,
-					 const uint64_t recv_timestamp )
+/* Transform into the header of an ack */
+void ContestMessage::Header::transform_into_ack( const uint64_t s_sequence_number,
+						 const uint64_t recv_timestamp,
+						 const uint64_t payload_length )
 {
   /* ack the old sequence number */
-  header.ack_sequence_number = header.sequence_number;
+  ack_sequence_number = sequence_number;
 
   /* now assign a new sequence number for the outgoing ack */
-  header.sequence_number = sequence_number;
+  sequence_number = s_sequence_number;
 
   /* ack the other fields */
-  header.ack_send_timestamp = header.send_timestamp;
-  header.ack_recv_timestamp = recv_timestamp;
-  header.ack_payload_length = payload.length();
+  ack_send_timestamp = send_timestamp;
+  ack_recv_timestamp = recv_timestamp;
+  ack_payload_length = payload_length;
+}
+
+/* Transform into an ack of the ContestMessage */
+void ContestMessage::transform_into_ack( const uint64_t sequence_number,
+					 const uint64_t recv_timestamp )
+{
+  header.transform_into_ack( sequence_number, recv_timestamp, payload.length() );
 
   /* delete the payload */
   payload.clear();
@@ -101,8 +132,89 @@ ContestMessage::Header::Header( const uint64_t s_sequence_number )
     ack_payload_length( -1 )
 {}
 
+/* Is this the header of an ack? */
+bool ContestMessage::Header::is_ack() const
+{
+  return ack_sequence_number != uint64_t( -1 );
+}
+
 /* Is this message an ack? */
 bool ContestMessage::is_ack() const
 {
-  return header.ack_sequence_number != uint64_t( -1 );
+  return header.is_ack();
+}
+
+/* helper to get a uint64_t trailer field (in network byte order) at a byte offset */
+static uint64_t get_field64( const size_t offset, const char * const data, const size_t length )
+{
+  if ( length < offset + sizeof( uint64_t ) ) {
+    throw runtime_error( "coalesced ack too small for its trailer" );
+  }
+
+  uint64_t network_order;
+  memcpy( &network_order, data + offset, sizeof( network_order ) );
+
+  return be64toh( network_order );
+}
+
+/* helper to get a uint32_t trailer field (in network byte order) at a byte offset */
+static uint32_t get_field32( const size_t offset, const char * const data, const size_t length )
+{
+  if ( length < offset + sizeof( uint32_t ) ) {
+    throw runtime_error( "coalesced ack too small for its bitmap" );
+  }
+
+  uint32_t network_order;
+  memcpy( &network_order, data + offset, sizeof( network_order ) );
+
+  return be32toh( network_order );
+}
+
+CoalescedAck::CoalescedAck()
+  : arrived(),
+    bitmap( 0 ),
+    recv_offsets()
+{}
+
+/* Parse trailer in place from a caller-owned buffer */
+CoalescedAck::CoalescedAck( const char * const data, const size_t length )
+  : arrived(),
+    bitmap( get_field64( sizeof( arrived ), data, length ) ),
+    recv_offsets()
+{
+  for ( unsigned int word = 0; word < HISTORY / 64; word++ ) {
+    arrived[ word ] = get_field64( word * sizeof( uint64_t ), data, length );
+  }
+
+  size_t offset = sizeof( arrived ) + sizeof( uint64_t );
+  for ( unsigned int i = 0; i < MAX_DATAGRAMS; i++ ) {
+    if ( bitmap & (uint64_t( 1 ) << i) ) {
+      recv_offsets[ i ] = get_field32( offset, data, length );
+      offset += sizeof( uint32_t );
+    }
+  }
+}
+
+/* Size of the trailer on the wire */
+size_t CoalescedAck::wire_size() const
+{
+  return sizeof( arrived ) + sizeof( uint64_t ) + __builtin_popcountll( bitmap ) * sizeof( uint32_t );
+}
+
+/* Write wire representation into a caller-owned buffer */
+void CoalescedAck::serialize( char * const data ) const
+{
+  for ( unsigned int word = 0; word < HISTORY / 64; word++ ) {
+    put_header_field( word, arrived[ word ], data );
+  }
+  put_header_field( HISTORY / 64, bitmap, data );
+
+  size_t offset = sizeof( arrived ) + sizeof( uint64_t );
+  for ( unsigned int i = 0; i < MAX_DATAGRAMS; i++ ) {
+    if ( bitmap & (uint64_t( 1 ) << i) ) {
+      const uint32_t network_order = htobe32( recv_offsets[ i ] );
+      memcpy( data + offset, &network_order, sizeof( network_order ) );
+      offset += sizeof( uint32_t );
+    }
+  }
 }
@@ -3,9 +3,12 @@
 
 #include <string>
 #include <cstdint>
+#include <cstddef>
 
 struct ContestMessage
 {
+  /* All timestamps are in microseconds, each on its host's monotonic
+     clock (see timestamp.hh) */
   struct Header {
     uint64_t sequence_number;
     uint64_t send_timestamp;
@@ -15,14 +18,36 @@ struct ContestMessage
     uint64_t ack_recv_timestamp;
     uint64_t ack_payload_length;
 
+    /* Size of the header on the wire */
+    static const size_t WIRE_SIZE = 6 * sizeof( uint64_t );
+
     /* Header for new message */
     Header( const uint64_t s_sequence_number );
 
     /* Parse header from wire */
     Header( const std::string & str );
 
+    /* Parse header in place from a caller-owned buffer */
+    Header( const char * const data, const size_t length );
+
+    /* Write wire representation of header into a caller-owned buffer
+       (which must have room for WIRE_SIZE bytes) */
+    void serialize( char * const data ) const;
+
     /* Make wire representation of header */
     std::string to_string() const;
+
+    /* Fill in the send_timestamp for an outgoing datagram */
+    void set_send_timestamp();
+
+    /* Transform into the header of an ack for a message
+       that carried payload_length bytes of payload */
+    void transform_into_ack( const uint64_t s_sequence_number,
+			     const uint64_t recv_timestamp,
+			     const uint64_t payload_length );
+
+    /* Is this the header of an ack? */
+    bool is_ack() const;
   } header;
 
   std::string payload;
@@ -48,4 +73,43 @@ struct ContestMessage
   bool is_ack() const;
 };
 
+/* Trailer of a coalesced ack, which follows the header in place of a
+   payload and acknowledges several datagrams at once. The header's ack_*
+   fields describe the newest of them (the one with the highest sequence
+   number); the trailer covers the others. */
+struct CoalescedAck
+{
+  /* largest number of datagrams one ack can cover */
+  static const unsigned int MAX_DATAGRAMS = 64;
+
+  /* how far back from header.ack_sequence_number arrivals are reported */
+  static const unsigned int HISTORY = 256;
+
+  /* bit (i % 64) of arrived[ i / 64 ] set: datagram
+     (header.ack_sequence_number - i) has arrived, whether or not an
+     earlier ack covered it. Successive acks overlap, so the datagrams
+     of a lost ack are still reported, though without receive times. */
+  uint64_t arrived[ HISTORY / 64 ];
+
+  /* bit i set: datagram (header.ack_sequence_number - i) is acknowledged
+     here for the first time, with its receive time */
+  uint64_t bitmap;
+
+  /* for each distance i with its bit set: how many microseconds before
+     header.ack_recv_timestamp that datagram arrived (negative if after) */
+  int32_t recv_offsets[ MAX_DATAGRAMS ];
+
+  CoalescedAck();
+
+  /* Parse trailer in place from a caller-owned buffer */
+  CoalescedAck( const char * const data, const size_t length );
+
+  /* Size of the trailer on the wire */
+  size_t wire_size() const;
+
+  /* Write wire representation into a caller-owned buffer
+     (which must have room for wire_size() bytes) */
+  void serialize( char * const data ) const;
+};
+
 #endif /* CONTEST_MESSAGE_HH */
@@ -2,63 +2,77 @@
 #define CONTROLLER_HH
 
 #include <cstdint>
-#include <cstdio>
-#include <set>
+#include <memory>
+#include <string>
+#include <vector>
 
-using namespace std;
+class PathModel;
 
-/* Congestion controller interface */
+/* Congestion controller interface. Each algorithm implements it, and
+   the registry below builds one by name (as sender cc=NAME does). */
 
 class Controller
 {
-private:
+protected:
   bool debug_; /* Enables debugging output */
+  unsigned int flow_id_; /* which flow this controller drives (for the event log) */
 
-  /* Add member variables here */
-  const float alpha;
-  const float beta;
-  float window_size_;
-  int state;
-  bool update;
-  int outstanding;
-  float prob_probability;
-  float rtt;
-  float queue_delay;
-  long q_;
-  long timeout;
-  int target;
-  int left;
-  long next_transmission;
-  pair<long, long> last_ack; 
-  set< pair<uint64_t, uint64_t> > ts_rtt;
-  void update_member(bool timeout, int state);
-  void get_stat(float &min, float &mean, float &dev);
 public:
-  /* Public interface for the congestion controller */
-  /* You can change these if you prefer, but will need to change
-     the call site as well (in sender.cc) */
-
   /* Default constructor */
-  Controller( const bool debug );
+  Controller( const bool debug ) : debug_( debug ), flow_id_( 0 ) {}
+
+  virtual ~Controller() {}
+
+  /* Label this controller's event-log records with a flow */
+  void set_flow_id( const unsigned int flow_id ) { flow_id_ = flow_id; }
 
   /* Get current window size, in datagrams */
-  unsigned int window_size();
+  virtual unsigned int window_size() = 0;
 
   /* A datagram was sent */
-  void datagram_was_sent( const uint64_t sequence_number,
-        const uint64_t send_timestamp,
-        const bool after_timeout );
+  virtual void datagram_was_sent( const uint64_t sequence_number,
+				  const uint64_t send_timestamp,
+				  const bool after_timeout ) = 0;
 
   /* An ack was received */
-  void ack_received( const uint64_t sequence_number_acked,
-         const uint64_t send_timestamp_acked,
-         const uint64_t recv_timestamp_acked,
-         const uint64_t timestamp_ack_received );
+  virtual void ack_received( const uint64_t sequence_number_acked,
+			     const uint64_t send_timestamp_acked,
+			     const uint64_t recv_timestamp_acked,
+			     const uint64_t timestamp_ack_received ) = 0;
 
-  /* How long to wait (in milliseconds) if there are no acks
+  /* A datagram was deemed lost (see scoreboard.hh) */
+  virtual void packet_lost( const uint64_t /* sequence_number */,
+			    const uint64_t /* send_timestamp */ ) {}
+
+  /* The sender's path model (delivery rate, bandwidth and min-RTT
+     estimates) took a new sample; called after ack_received() */
+  virtual void path_measured( const PathModel & ) {}
+
+  /* How long to wait (in microseconds) if there are no acks
      before sending one more datagram */
-  unsigned int timeout_ms();
+  virtual unsigned int timeout_us() = 0;
+
+  /* How fast to release datagrams while the window is open,
+     in datagrams per second (0 means send as fast as the window allows) */
+  virtual double pacing_rate() { return 0; }
+
+  /* Seed whatever random choices the algorithm makes (for repeatable runs) */
+  virtual void seed( const unsigned int /* seed */ ) {}
+
+  /* the algorithm used when none is named */
+  static const std::string DEFAULT_NAME;
+
+  /* build the named algorithm (throws if there is no such algorithm) */
+  static std::unique_ptr<Controller> make( const std::string & name, const bool debug );
+
+  /* is there an algorithm by this name? */
+  static bool exists( const std::string & name );
+
+  /* the names of every algorithm in the registry */
+  static std::vector<std::string> names();
 
+  /* every algorithm in the registry, as "name: description" lines */
+  static std::string describe_all();
 };
 
 #endif
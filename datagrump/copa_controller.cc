@@ -0,0 +1,147 @@
+#include <algorithm>
+
+#include "copa_controller.hh"
+#include "event_log.hh"
+
+using namespace std;
+
+constexpr double CopaController::MAX_VELOCITY;
+constexpr double CopaController::MAX_WINDOW;
+
+CopaController::CopaController( const bool debug )
+  : Controller( debug ),
+    window_( INITIAL_WINDOW ),
+    slow_start_( true ),
+    velocity_( 1 ),
+    direction_( 1 ),
+    rounds_in_direction_( 0 ),
+    window_at_round_start_( INITIAL_WINDOW ),
+    recent_rtts_(),
+    all_rtts_(),
+    srtt_us_( 0 ),
+    standing_rtt_us_( 0 ),
+    round_end_( 0 ),
+    next_sequence_number_( 0 ),
+    recovery_end_( 0 )
+{}
+
+unsigned int CopaController::window_size()
+{
+  return min( window_, MAX_WINDOW );
+}
+
+void CopaController::datagram_was_sent( const uint64_t sequence_number,
+					const uint64_t send_timestamp,
+					const bool after_timeout )
+{
+  next_sequence_number_ = max( next_sequence_number_, sequence_number + 1 );
+
+  if ( after_timeout ) {
+    back_off( sequence_number, send_timestamp, true );
+  }
+}
+
+void CopaController::packet_lost( const uint64_t sequence_number,
+				  const uint64_t send_timestamp )
+{
+  back_off( sequence_number, send_timestamp, false );
+}
+
+/* halve the window and start speeding up again from scratch, once per window */
+void CopaController::back_off( const uint64_t sequence_number,
+			       const uint64_t timestamp,
+			       const bool after_timeout )
+{
+  if ( sequence_number < recovery_end_ ) {
+    return;
+  }
+
+  window_ = max( 2.0, window_ / 2 );
+  slow_start_ = false;
+  velocity_ = 1;
+  rounds_in_direction_ = 0;
+  window_at_round_start_ = window_;
+  recovery_end_ = next_sequence_number_;
+
+  EventLog::log( EventLog::Type::WindowCut, timestamp, flow_id_, after_timeout, sequence_number,
+		 window_ );
+}
+
+/* once per round trip: speed up while the window keeps moving the same way */
+void CopaController::end_round()
+{
+  const int direction = window_ >= window_at_round_start_ ? 1 : -1;
+
+  if ( direction == direction_ ) {
+    rounds_in_direction_++;
+    if ( rounds_in_direction_ >= 3 ) {
+      velocity_ = min( 2 * velocity_, MAX_VELOCITY );
+    }
+  } else {
+    direction_ = direction;
+    rounds_in_direction_ = 0;
+    velocity_ = 1;
+  }
+
+  window_at_round_start_ = window_;
+  round_end_ = next_sequence_number_;
+}
+
+void CopaController::ack_received( const uint64_t sequence_number_acked,
+				   const uint64_t send_timestamp_acked,
+				   const uint64_t,
+				   const uint64_t timestamp_ack_received )
+{
+  const uint64_t rtt = max( uint64_t( 1 ), timestamp_ack_received - send_timestamp_acked );
+  srtt_us_ = srtt_us_ > 0 ? 0.875 * srtt_us_ + 0.125 * rtt : rtt;
+
+  recent_rtts_.push( timestamp_ack_received, rtt );
+  recent_rtts_.expire( timestamp_ack_received, srtt_us_ / 2 );
+  all_rtts_.push( timestamp_ack_received, rtt );
+  all_rtts_.expire( timestamp_ack_received, MIN_RTT_WINDOW_US );
+
+  standing_rtt_us_ = recent_rtts_.min();
+  const double queueing_delay_us = standing_rtt_us_ - all_rtts_.min();
+
+  /* compare the current rate with the target, both in datagrams per second */
+  const double rate = window_ * 1e6 / standing_rtt_us_;
+  const bool below_target = queueing_delay_us <= 0
+    or rate <= 1e6 / (DELTA * queueing_delay_us);
+
+  if ( slow_start_ ) {
+    if ( below_target ) {
+      window_ = min( window_ + 1, MAX_WINDOW ); /* doubles once per round trip */
+    } else {
+      slow_start_ = false;
+    }
+  }
+
+  if ( not slow_start_ ) {
+    const double step = velocity_ / (DELTA * window_);
+    window_ = below_target ? min( window_ + step, MAX_WINDOW ) : max( 2.0, window_ - step );
+  }
+
+  if ( sequence_number_acked >= round_end_ ) {
+    end_round();
+    EventLog::log( EventLog::Type::ControllerState, timestamp_ack_received, flow_id_,
+		   slow_start_, sequence_number_acked, window_, 0, velocity_ );
+  }
+
+  EventLog::log( EventLog::Type::RttSample, timestamp_ack_received, flow_id_, 0, sequence_number_acked,
+		 rtt, srtt_us_, all_rtts_.min(), queueing_delay_us, window_ );
+}
+
+unsigned int CopaController::timeout_us()
+{
+  /* wait a second for the first RTT sample, then twice the smoothed RTT */
+  return srtt_us_ > 0 ? max( 2 * srtt_us_, 20000.0 ) : 1000000;
+}
+
+double CopaController::pacing_rate()
+{
+  if ( standing_rtt_us_ <= 0 ) {
+    return 0;
+  }
+
+  return 2 * window_ * 1e6 / standing_rtt_us_;
+}
@@ -0,0 +1,70 @@
+#ifndef COPA_CONTROLLER_HH
+#define COPA_CONTROLLER_HH
+
+#include <cstdint>
+
+#include "controller.hh"
+#include "windowed_stats.hh"
+
+/* Copa (Arun and Balakrishnan, NSDI 2018): aim for a sending rate of
+   1 / (DELTA * queueing delay), where queueing delay is the "standing"
+   RTT (the minimum over the last half RTT) less the minimum RTT. The
+   window moves toward the target by velocity / (DELTA * window) per ack,
+   and the velocity doubles (up to MAX_VELOCITY) while the window keeps
+   moving the same way. A loss or timeout halves the window, at most once
+   per round trip, and resets the velocity. */
+
+class CopaController : public Controller
+{
+private:
+  double window_; /* in datagrams */
+  bool slow_start_;
+  double velocity_;
+
+  /* direction the window moved over the last round (+1 or -1),
+     and for how many rounds in a row it has moved that way */
+  int direction_;
+  unsigned int rounds_in_direction_;
+  double window_at_round_start_;
+
+  WindowedStats recent_rtts_; /* over the last half smoothed RTT */
+  WindowedStats all_rtts_; /* over the last MIN_RTT_WINDOW_US */
+  double srtt_us_;
+  double standing_rtt_us_;
+
+  /* the round ends once this datagram is acknowledged */
+  uint64_t round_end_;
+  uint64_t next_sequence_number_;
+
+  /* losses of datagrams sent before this are part of the last back-off */
+  uint64_t recovery_end_;
+
+  void end_round();
+  void back_off( const uint64_t sequence_number, const uint64_t timestamp, const bool after_timeout );
+
+public:
+  static constexpr double DELTA = 0.5;
+  static constexpr double INITIAL_WINDOW = 10;
+  static const uint64_t MIN_RTT_WINDOW_US = 10000000;
+  static constexpr double MAX_VELOCITY = 64;
+  static constexpr double MAX_WINDOW = 65536;
+
+  CopaController( const bool debug );
+
+  unsigned int window_size() override;
+  void datagram_was_sent( const uint64_t sequence_number,
+			  const uint64_t send_timestamp,
+			  const bool after_timeout ) override;
+  void ack_received( const uint64_t sequence_number_acked,
+		     const uint64_t send_timestamp_acked,
+		     const uint64_t recv_timestamp_acked,
+		     const uint64_t timestamp_ack_received ) override;
+  void packet_lost( const uint64_t sequence_number,
+		    const uint64_t send_timestamp ) override;
+  unsigned int timeout_us() override;
+
+  /* Copa paces at twice the window per standing RTT */
+  double pacing_rate() override;
+};
+
+#endif /* COPA_CONTROLLER_HH */
@@ -0,0 +1,110 @@
+/* turn a binary event log (from sender or simulator log=FILE) into CSV */
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "event_log.hh"
+
+using namespace std;
+
+/* one field as CSV: integers without a decimal point */
+static void print_value( const double value )
+{
+  if ( value == uint64_t( value ) ) {
+    cout << uint64_t( value );
+  } else {
+    cout << value;
+  }
+}
+
+int main( int argc, char *argv[] )
+{
+   /* check the command-line arguments */
+  if ( argc < 1 ) { /* for sticklers */
+    abort();
+  }
+
+  if ( argc < 2 or argc > 3 ) {
+    cerr << "Usage: " << argv[ 0 ] << " LOGFILE [event=NAME]" << endl
+	 << "(with an event named, only those records are printed, with named columns)" << endl;
+    return EXIT_FAILURE;
+  }
+
+  const EventLog::Schema * only = nullptr;
+  if ( argc == 3 ) {
+    const string arg = argv[ 2 ];
+    if ( arg.substr( 0, 6 ) != "event=" or not (only = EventLog::schema( arg.substr( 6 ) )) ) {
+      cerr << "Unknown option: " << arg << endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  ifstream file( argv[ 1 ], ios::binary );
+  string magic( EventLog::MAGIC.size(), 0 );
+  if ( not file.read( &magic[ 0 ], magic.size() ) or magic != EventLog::MAGIC ) {
+    cerr << argv[ 1 ] << ": not an event log" << endl;
+    return EXIT_FAILURE;
+  }
+
+  /* header: generic columns, or the chosen event's own names */
+  if ( only ) {
+    cout << "time_us,flow";
+    for ( const char * column : { only->state, only->sequence_number } ) {
+      if ( column ) {
+	cout << "," << column;
+      }
+    }
+    for ( const char * column : only->values ) {
+      if ( column ) {
+	cout << "," << column;
+      }
+    }
+  } else {
+    cout << "time_us,flow,event,state,sequence_number,value1,value2,value3,value4,value5";
+  }
+  cout << "\n";
+
+  EventLog::Record record;
+  uint64_t count = 0;
+  while ( file.read( reinterpret_cast<char *>( &record ), sizeof( record ) ) ) {
+    const EventLog::Schema * const schema = EventLog::schema( record.type );
+    if ( only and schema != only ) {
+      continue;
+    }
+
+    count++;
+    cout << record.timestamp << "," << record.flow;
+
+    if ( only ) {
+      if ( only->state ) {
+	cout << "," << record.state;
+      }
+      if ( only->sequence_number ) {
+	cout << "," << record.sequence_number;
+      }
+      for ( unsigned int i = 0; i < 5; i++ ) {
+	if ( only->values[ i ] ) {
+	  cout << ",";
+	  print_value( record.values[ i ] );
+	}
+      }
+    } else {
+      cout << "," << (schema ? schema->name : "unknown")
+	   << "," << record.state << "," << record.sequence_number;
+      for ( const double value : record.values ) {
+	cout << ",";
+	print_value( value );
+      }
+    }
+    cout << "\n";
+  }
+
+  if ( file.gcount() ) {
+    cerr << argv[ 1 ] << ": ignored a truncated record at the end" << endl;
+  }
+
+  cerr << "Decoded " << count << " records" << endl;
+  return EXIT_SUCCESS;
+}
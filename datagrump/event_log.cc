@@ -0,0 +1,207 @@
+#include <chrono>
+#include <iostream>
+
+#include <fcntl.h>
+
+#include "event_log.hh"
+#include "util.hh"
+
+using namespace std;
+
+static_assert( sizeof( EventLog::Record ) == 64, "event records must be 64 bytes" );
+
+const string EventLog::MAGIC = string( "DGEVLOG1" );
+
+atomic<EventLog *> EventLog::global_( nullptr );
+unique_ptr<EventLog> EventLog::global_owner_;
+atomic<unsigned int> EventLog::producers_( 0 );
+
+EventLog::EventLog( const string & filename, const bool wait_when_full )
+  : slots_( new Slot[ CAPACITY ] ),
+    enqueue_position_( 0 ),
+    dequeue_position_( 0 ),
+    dropped_( 0 ),
+    wait_when_full_( wait_when_full ),
+    file_( SystemCall( "open " + filename,
+		       ::open( filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644 ) ) ),
+    running_( true ),
+    flusher_(),
+    write_error_()
+{
+  for ( size_t i = 0; i < CAPACITY; i++ ) {
+    slots_[ i ].sequence.store( i, memory_order_relaxed );
+  }
+
+  file_.write( MAGIC );
+
+  flusher_ = thread( [&] () { flush_loop(); } );
+}
+
+EventLog::~EventLog()
+{
+  stop();
+
+  if ( dropped() ) {
+    cerr << "Event log dropped " << dropped() << " records (ring full)" << endl;
+  }
+
+  /* (unless close() has already reported it) */
+  if ( write_error_ ) {
+    try {
+      rethrow_exception( write_error_ );
+    } catch ( const exception & e ) {
+      print_exception( e );
+    }
+  }
+}
+
+void EventLog::stop()
+{
+  if ( flusher_.joinable() ) {
+    running_.store( false, memory_order_release );
+    flusher_.join();
+  }
+}
+
+bool EventLog::push( const Record & record )
+{
+  uint64_t position = enqueue_position_.load( memory_order_relaxed );
+  Slot * slot;
+
+  /* claim a slot whose previous record has been drained */
+  while ( true ) {
+    slot = &slots_[ position & (CAPACITY - 1) ];
+    const int64_t turn = slot->sequence.load( memory_order_acquire ) - position;
+
+    if ( turn == 0 ) {
+      if ( enqueue_position_.compare_exchange_weak( position, position + 1, memory_order_relaxed ) ) {
+	break;
+      }
+    } else if ( turn < 0 and not wait_when_full_ ) {
+      dropped_.fetch_add( 1, memory_order_relaxed );
+      return false;
+    } else if ( turn < 0 ) {
+      this_thread::yield(); /* let the flusher catch up */
+      position = enqueue_position_.load( memory_order_relaxed );
+    } else {
+      position = enqueue_position_.load( memory_order_relaxed );
+    }
+  }
+
+  slot->record = record;
+  slot->sequence.store( position + 1, memory_order_release );
+  return true;
+}
+
+size_t EventLog::drain( string & buffer )
+{
+  size_t count = 0;
+
+  while ( true ) {
+    Slot & slot = slots_[ dequeue_position_ & (CAPACITY - 1) ];
+    if ( slot.sequence.load( memory_order_acquire ) != dequeue_position_ + 1 ) {
+      return count; /* not yet written */
+    }
+
+    buffer.append( reinterpret_cast<const char *>( &slot.record ), sizeof( slot.record ) );
+    slot.sequence.store( dequeue_position_ + CAPACITY, memory_order_release );
+    dequeue_position_++;
+    count++;
+  }
+}
+
+void EventLog::flush_loop()
+{
+  string buffer;
+
+  while ( true ) {
+    const bool last_pass = not running_.load( memory_order_acquire );
+
+    buffer.clear();
+    if ( drain( buffer ) ) {
+      /* (an exception here would end the process; keep draining
+	 after a failure, so producers waiting for room don't hang) */
+      if ( not write_error_ ) {
+	try {
+	  file_.write( buffer );
+	} catch ( const exception & ) {
+	  write_error_ = current_exception();
+	}
+      }
+    } else if ( last_pass ) {
+      return;
+    } else {
+      this_thread::sleep_for( chrono::milliseconds( 1 ) );
+    }
+  }
+}
+
+void EventLog::open( const string & filename, const bool wait_when_full )
+{
+  close();
+  global_owner_.reset( new EventLog( filename, wait_when_full ) );
+  global_.store( global_owner_.get(), memory_order_release );
+}
+
+void EventLog::close()
+{
+  /* once no log() call can still see the log, it can be freed */
+  global_.store( nullptr );
+  while ( producers_.load() ) {
+    this_thread::yield();
+  }
+
+  unique_ptr<EventLog> log( move( global_owner_ ) );
+  if ( not log ) {
+    return;
+  }
+
+  log->stop();
+  const exception_ptr error = log->write_error_;
+  log->write_error_ = nullptr;
+  log.reset();
+
+  if ( error ) {
+    rethrow_exception( error );
+  }
+}
+
+/* what each record type's fields mean */
+static const EventLog::Schema schemas[] = {
+  { "sent", "after_timeout", "sequence_number",
+    { "window", "timeout_us", "pacing_rate", nullptr, nullptr } },
+  { "acked", nullptr, "sequence_number",
+    { "rtt_us", "send_timestamp", "recv_timestamp", "window", nullptr } },
+  { "lost", nullptr, "sequence_number",
+    { "send_timestamp", nullptr, nullptr, nullptr, nullptr } },
+  { "state_machine_state", "state", "sequence_number",
+    { "q_us", "queue_delay_us", "target", "outstanding", "timeout_us" } },
+  { "state_machine_transition", "state", "sequence_number",
+    { "previous_state", "target", "q_us", "probe_probability", "short_circuit" } },
+  { "window_cut", "timeout", "sequence_number",
+    { "window", nullptr, nullptr, nullptr, nullptr } },
+  { "rtt_sample", nullptr, "sequence_number",
+    { "rtt_us", "srtt_us", "min_rtt_us", "queueing_delay_us", "window" } },
+  { "controller_state", "slow_start", "sequence_number",
+    { "window", "queued", "velocity", nullptr, nullptr } },
+};
+
+const EventLog::Schema * EventLog::schema( const uint16_t type )
+{
+  if ( type < 1 or type > sizeof( schemas ) / sizeof( schemas[ 0 ] ) ) {
+    return nullptr;
+  }
+
+  return &schemas[ type - 1 ];
+}
+
+const EventLog::Schema * EventLog::schema( const string & name )
+{
+  for ( const auto & s : schemas ) {
+    if ( name == s.name ) {
+      return &s;
+    }
+  }
+
+  return nullptr;
+}
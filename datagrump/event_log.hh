@@ -0,0 +1,140 @@
+#ifndef EVENT_LOG_HH
+#define EVENT_LOG_HH
+
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "file_descriptor.hh"
+
+/* Binary telemetry log. Each event is a fixed 64-byte record, pushed
+   without locks or syscalls into a preallocated ring buffer (a bounded
+   multi-producer queue, as in Dmitry Vyukov's design); a background
+   thread drains the ring to a file. If the ring is full, the event is
+   dropped and counted rather than holding up the caller (unless the log
+   was opened to wait, as the simulator does, whose clock is virtual).
+   The decode-log program turns a log into CSV. */
+
+class EventLog
+{
+public:
+  enum class Type : uint16_t {
+    Sent = 1, /* a datagram went out */
+    Acked, /* a datagram's ack came back */
+    Lost, /* a datagram was deemed lost */
+    StateMachineState, /* state-machine controller, after each ack */
+    StateMachineTransition, /* state-machine controller changed state */
+    WindowCut, /* another controller cut its window for a loss or timeout */
+    RttSample, /* another controller took an RTT sample from an ack */
+    ControllerState, /* another controller adjusted its window for a round trip */
+  };
+
+  struct Record
+  {
+    uint64_t timestamp; /* microseconds */
+    uint16_t type; /* a Type */
+    uint16_t flow;
+    int32_t state; /* meaning depends on the type (see event_log.cc) */
+    uint64_t sequence_number;
+    double values[ 5 ]; /* likewise */
+  };
+
+  /* records the ring can hold before events are dropped */
+  static const size_t CAPACITY = 1 << 16;
+
+  /* every log file starts with this */
+  static const std::string MAGIC;
+
+  EventLog( const std::string & filename, const bool wait_when_full = false );
+  ~EventLog();
+
+  /* queue a record; returns false if the ring was full and it was dropped */
+  bool push( const Record & record );
+
+  uint64_t dropped() const { return dropped_.load( std::memory_order_relaxed ); }
+
+  /* the process-wide log, which log() writes to (if one is open). close()
+     waits for any thread still logging to it, and throws if writing the
+     file failed. */
+  static void open( const std::string & filename, const bool wait_when_full = false );
+  static void close();
+
+  /* is the process-wide log open? (to skip work only needed for logging) */
+  static bool enabled() { return global_.load( std::memory_order_relaxed ) != nullptr; }
+
+  static void log( const Type type, const uint64_t timestamp, const unsigned int flow,
+		   const int32_t state, const uint64_t sequence_number,
+		   const double v0 = 0, const double v1 = 0, const double v2 = 0,
+		   const double v3 = 0, const double v4 = 0 )
+  {
+    /* with no log open, skip the counting below */
+    if ( not enabled() ) {
+      return;
+    }
+
+    /* (counted while the log might be in use, so close() can wait it out;
+       the log is looked up again once counted) */
+    producers_.fetch_add( 1 );
+    EventLog * const log = global_.load();
+    if ( log ) {
+      log->push( { timestamp, uint16_t( type ), uint16_t( flow ), state, sequence_number,
+		   { v0, v1, v2, v3, v4 } } );
+    }
+    producers_.fetch_sub( 1, std::memory_order_release );
+  }
+
+  /* how to label a record's fields: the type's name, then names for
+     state, sequence_number and values (nullptr where unused) */
+  struct Schema
+  {
+    const char * name;
+    const char * state;
+    const char * sequence_number;
+    const char * values[ 5 ];
+  };
+
+  /* schema for a record type (nullptr if unknown) */
+  static const Schema * schema( const uint16_t type );
+  static const Schema * schema( const std::string & name );
+
+private:
+  struct Slot
+  {
+    std::atomic<uint64_t> sequence; /* whose turn it is: producer or consumer */
+    Record record;
+  };
+
+  std::unique_ptr<Slot[]> slots_;
+
+  /* producers claim positions here; the flusher alone advances dequeue_position_ */
+  std::atomic<uint64_t> enqueue_position_;
+  uint64_t dequeue_position_;
+  std::atomic<uint64_t> dropped_;
+  bool wait_when_full_;
+
+  FileDescriptor file_;
+  std::atomic<bool> running_;
+  std::thread flusher_;
+
+  /* why writing the file failed, if it did (set by the flusher, which
+     then discards what it drains; read once it has stopped) */
+  std::exception_ptr write_error_;
+
+  /* move whatever is queued into buffer, returning how many records */
+  size_t drain( std::string & buffer );
+  void flush_loop();
+
+  /* write out what is queued and wait for the flusher to finish */
+  void stop();
+
+  static std::atomic<EventLog *> global_;
+  static std::unique_ptr<EventLog> global_owner_;
+
+  /* how many log() calls are under way */
+  static std::atomic<unsigned int> producers_;
+};
+
+#endif /* EVENT_LOG_HH */
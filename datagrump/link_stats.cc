@@ -0,0 +1,72 @@
+#include <algorithm>
+#include <limits>
+
+#include "link_stats.hh"
+
+using namespace std;
+
+static const uint64_t NEVER = numeric_limits<uint64_t>::max();
+
+double percentile_95( vector<uint64_t> & samples )
+{
+  if ( samples.empty() ) {
+    return 0;
+  }
+
+  const size_t rank = (samples.size() * 95 + 99) / 100 - 1;
+  nth_element( samples.begin(), samples.begin() + rank, samples.end() );
+  return samples[ rank ];
+}
+
+SignalDelay::SignalDelay()
+  : best_(), first_ms_( NEVER )
+{}
+
+void SignalDelay::add( const uint64_t sent_us, const uint64_t delivered_us )
+{
+  const uint64_t sent_ms = sent_us / 1000;
+  const uint64_t delay_ms = delivered_us / 1000 - sent_ms;
+
+  if ( sent_ms >= best_.size() ) {
+    best_.resize( max( sent_ms + 1, 2 * best_.size() ), NEVER );
+  }
+
+  best_[ sent_ms ] = min( best_[ sent_ms ], delay_ms );
+  first_ms_ = min( first_ms_, sent_ms );
+}
+
+void SignalDelay::merge( const SignalDelay & other )
+{
+  if ( other.best_.size() > best_.size() ) {
+    best_.resize( other.best_.size(), NEVER );
+  }
+
+  for ( size_t i = 0; i < other.best_.size(); i++ ) {
+    best_[ i ] = min( best_[ i ], other.best_[ i ] );
+  }
+
+  first_ms_ = min( first_ms_, other.first_ms_ );
+}
+
+double SignalDelay::p95_ms() const
+{
+  if ( first_ms_ == NEVER ) {
+    return 0;
+  }
+
+  /* the last millisecond anything was sent */
+  size_t last_ms = best_.size() - 1;
+  while ( best_[ last_ms ] == NEVER ) {
+    last_ms--;
+  }
+
+  vector<uint64_t> signal_delays;
+  signal_delays.reserve( last_ms - first_ms_ + 1 );
+  uint64_t running = NEVER;
+  for ( size_t i = last_ms + 1; i-- > first_ms_; ) {
+    running = min( running == NEVER ? NEVER : running + 1, best_[ i ] );
+    signal_delays.push_back( running );
+  }
+
+  return percentile_95( signal_delays );
+}
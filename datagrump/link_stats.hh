@@ -0,0 +1,40 @@
+#ifndef LINK_STATS_HH
+#define LINK_STATS_HH
+
+#include <cstdint>
+#include <vector>
+
+/* The contest's delay measures, shared by the simulator and the
+   analyzer of mahimahi link logs. */
+
+/* 95th percentile of some samples (reorders them) */
+double percentile_95( std::vector<uint64_t> & samples );
+
+/* Signal delay, as mm-throughput-graph defines it: at each millisecond,
+   how long until something sent at or after that moment is delivered.
+   Keeps one entry per millisecond of sending, not one per packet, so
+   deliveries can be added as they stream by (in any order), and
+   accumulators for different parts of a log can be merged. */
+class SignalDelay
+{
+private:
+  /* soonest delivery (relative to its send time, in ms) of the
+     packets sent in each millisecond */
+  std::vector<uint64_t> best_;
+  uint64_t first_ms_; /* first millisecond anything was sent */
+
+public:
+  SignalDelay();
+
+  /* a packet sent at sent_us was delivered at delivered_us */
+  void add( const uint64_t sent_us, const uint64_t delivered_us );
+
+  /* fold in another accumulator's deliveries */
+  void merge( const SignalDelay & other );
+
+  /* 95th percentile over every millisecond from the first send
+     to the last (0 if nothing was delivered) */
+  double p95_ms() const;
+};
+
+#endif /* LINK_STATS_HH */
@@ -0,0 +1,68 @@
+#include <algorithm>
+#include <limits>
+
+#include "pacer.hh"
+#include "timestamp.hh"
+
+using namespace std;
+
+Pacer::Pacer()
+  : timer_(),
+    next_release_ns_( 0 ),
+    interval_ns_( 0 )
+{}
+
+/* set the pacing rate */
+void Pacer::set_rate( const double datagrams_per_second )
+{
+  interval_ns_ = datagrams_per_second > 0 ? 1e9 / datagrams_per_second : 0;
+}
+
+/* nanoseconds until the next datagram may go out */
+uint64_t Pacer::wait_ns( const uint64_t now_ns ) const
+{
+  if ( interval_ns_ == 0 or next_release_ns_ <= now_ns ) {
+    return 0;
+  }
+
+  return next_release_ns_ - now_ns;
+}
+
+/* how many datagrams may go out now */
+unsigned int Pacer::allowance( const uint64_t now_ns ) const
+{
+  if ( interval_ns_ == 0 ) {
+    return numeric_limits<unsigned int>::max();
+  }
+
+  if ( next_release_ns_ > now_ns ) {
+    return 0;
+  }
+
+  const uint64_t behind = min( now_ns - next_release_ns_, MAX_CREDIT_NS );
+  return 1 + behind / interval_ns_;
+}
+
+/* count datagrams that just went out */
+void Pacer::released( const uint64_t now_ns, const unsigned int count )
+{
+  const uint64_t earliest = now_ns > MAX_CREDIT_NS ? now_ns - MAX_CREDIT_NS : 0;
+  next_release_ns_ = max( next_release_ns_, earliest ) + count * interval_ns_;
+}
+
+/* busy-wait until the next datagram may go out */
+uint64_t Pacer::spin() const
+{
+  uint64_t now;
+  while ( wait_ns( now = timestamp_ns() ) > 0 ) {}
+  return now;
+}
+
+/* if the next release is far enough away, arm the timer for it */
+void Pacer::schedule( const uint64_t now_ns )
+{
+  const uint64_t wait = wait_ns( now_ns );
+  if ( wait > SPIN_NS and not timer_.armed() ) {
+    timer_.arm( wait - SPIN_NS );
+  }
+}
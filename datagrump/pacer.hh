@@ -0,0 +1,57 @@
+#ifndef PACER_HH
+#define PACER_HH
+
+#include <cstdint>
+
+#include "timerfd.hh"
+
+/* Releases datagrams no faster than a given rate. Waits longer than
+   SPIN_NS are handed to a timerfd (so the event loop keeps running);
+   the last stretch before a release is spun out, since timer wakeups
+   are only accurate to tens of microseconds. */
+
+class Pacer
+{
+private:
+  TimerFD timer_;
+
+  /* when the next datagram may go out (timestamp_ns() clock) */
+  uint64_t next_release_ns_;
+
+  /* nanoseconds between datagrams at the current rate (0: unpaced) */
+  uint64_t interval_ns_;
+
+public:
+  /* waits shorter than this are spun rather than slept */
+  static const uint64_t SPIN_NS = 20000;
+
+  /* how far behind schedule the pacer may fall and still catch up,
+     which absorbs late wakeups without permitting large bursts */
+  static const uint64_t MAX_CREDIT_NS = 200000;
+
+  Pacer();
+
+  /* set the pacing rate, in datagrams per second (0: unpaced) */
+  void set_rate( const double datagrams_per_second );
+
+  /* nanoseconds until the next datagram may go out (0 if one may now) */
+  uint64_t wait_ns( const uint64_t now_ns ) const;
+
+  /* how many datagrams may go out now */
+  unsigned int allowance( const uint64_t now_ns ) const;
+
+  /* count datagrams that just went out */
+  void released( const uint64_t now_ns, const unsigned int count );
+
+  /* busy-wait until the next datagram may go out, returning the time */
+  uint64_t spin() const;
+
+  /* if the next release is far enough away, arm the timer for it */
+  void schedule( const uint64_t now_ns );
+
+  /* timerfd to poll on while a release is scheduled */
+  TimerFD & timer() { return timer_; }
+  bool scheduled() const { return timer_.armed(); }
+};
+
+#endif /* PACER_HH */
@@ -0,0 +1,84 @@
+#include <algorithm>
+
+#include "path_model.hh"
+
+using namespace std;
+
+PathModel::PathModel()
+  : sent_( HISTORY, { uint64_t( -1 ), 0, 0, 0, 0, 0, true } ),
+    next_sequence_number_( 0 ),
+    next_ack_expected_( 0 ),
+    delivered_bytes_( 0 ),
+    delivered_datagrams_( 0 ),
+    delivered_time_( 0 ),
+    first_send_time_( 0 ),
+    round_count_( 0 ),
+    next_round_delivered_( 0 ),
+    max_bandwidth_( BANDWIDTH_WINDOW_ROUNDS ),
+    min_rtt_( MIN_RTT_WINDOW_US ),
+    latest_( { 0, 0, 0 } )
+{}
+
+void PathModel::datagram_sent( const uint64_t sequence_number,
+			       const uint64_t send_time,
+			       const uint64_t size )
+{
+  /* starting from idle: measure from now, not from the last ack */
+  if ( next_ack_expected_ >= next_sequence_number_ ) {
+    first_send_time_ = delivered_time_ = send_time;
+  }
+
+  sent_[ sequence_number % HISTORY ] = { sequence_number, send_time, size,
+					 delivered_bytes_, delivered_time_, first_send_time_,
+					 false };
+  next_sequence_number_ = max( next_sequence_number_, sequence_number + 1 );
+}
+
+bool PathModel::datagram_acked( const uint64_t sequence_number, const uint64_t now )
+{
+  SentDatagram & datagram = sent_[ sequence_number % HISTORY ];
+  if ( datagram.sequence_number != sequence_number or datagram.acked ) {
+    return false; /* forgotten already, or a duplicate */
+  }
+
+  datagram.acked = true;
+  next_ack_expected_ = max( next_ack_expected_, sequence_number + 1 );
+
+  delivered_bytes_ += datagram.size;
+  delivered_datagrams_++;
+  delivered_time_ = now;
+
+  const uint64_t rtt = now - datagram.send_time;
+  min_rtt_.update( now, rtt );
+
+  /* a round trip ends with the ack of a datagram sent after the last one ended */
+  if ( datagram.delivered >= next_round_delivered_ ) {
+    next_round_delivered_ = delivered_bytes_;
+    round_count_++;
+  }
+
+  /* the rate is limited by whichever was slower: sending or acking */
+  const uint64_t send_elapsed = datagram.send_time - datagram.first_send_time;
+  const uint64_t ack_elapsed = now - datagram.delivered_time;
+  const uint64_t interval = max( send_elapsed, ack_elapsed );
+  first_send_time_ = datagram.send_time;
+
+  /* intervals shorter than the min RTT would overestimate the rate */
+  if ( interval == 0 or interval < min_rtt_us() ) {
+    return false;
+  }
+
+  latest_ = { (delivered_bytes_ - datagram.delivered) * 1e6 / interval, interval, rtt };
+  max_bandwidth_.update( round_count_, latest_.delivery_rate );
+
+  return true;
+}
+
+double PathModel::bdp_datagrams() const
+{
+  if ( delivered_datagrams_ == 0 ) {
+    return 0;
+  }
+
+  return bdp_bytes() * delivered_datagrams_ / delivered_bytes_;
+}
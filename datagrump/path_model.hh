@@ -0,0 +1,92 @@
+#ifndef PATH_MODEL_HH
+#define PATH_MODEL_HH
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "windowed_filter.hh"
+
+/* What the sender has measured about the path, BBR-style: each ack
+   yields a delivery-rate sample (bytes delivered between when the
+   datagram was sent and when it was acked, over the longer of the send
+   and ack intervals), feeding a windowed-max bandwidth estimate and a
+   windowed-min RTT estimate. Their product is the bandwidth-delay product. */
+
+struct RateSample
+{
+  double delivery_rate; /* bytes per second */
+  uint64_t interval_us; /* over which the bytes were delivered */
+  uint64_t rtt_us; /* of the datagram that produced the sample */
+};
+
+class PathModel
+{
+private:
+  /* state recorded with each datagram when it is sent */
+  struct SentDatagram
+  {
+    uint64_t sequence_number;
+    uint64_t send_time;
+    uint64_t size;
+    uint64_t delivered; /* bytes delivered when it was sent */
+    uint64_t delivered_time; /* when the last of those was acked */
+    uint64_t first_send_time; /* send time of the datagram acked then */
+    bool acked;
+  };
+
+  /* recent datagrams, by sequence number modulo HISTORY */
+  static const uint64_t HISTORY = 16384;
+  std::vector<SentDatagram> sent_;
+
+  uint64_t next_sequence_number_; /* one past the newest datagram sent */
+  uint64_t next_ack_expected_; /* one past the newest datagram acked */
+
+  uint64_t delivered_bytes_;
+  uint64_t delivered_datagrams_;
+  uint64_t delivered_time_; /* when the newest ack arrived */
+  uint64_t first_send_time_; /* send time of the datagram it acked */
+
+  /* round trips are counted as acks for datagrams sent after the
+     previous round's end come back */
+  uint64_t round_count_;
+  uint64_t next_round_delivered_;
+
+  WindowedFilter< double, std::greater<double> > max_bandwidth_; /* over round trips */
+  WindowedFilter< uint64_t, std::less<uint64_t> > min_rtt_; /* over microseconds */
+
+  RateSample latest_;
+
+public:
+  /* how many round trips the bandwidth estimate remembers */
+  static const uint64_t BANDWIDTH_WINDOW_ROUNDS = 10;
+
+  /* how long the min-RTT estimate remembers */
+  static const uint64_t MIN_RTT_WINDOW_US = 10000000;
+
+  PathModel();
+
+  /* a datagram of size bytes was sent (sequence numbers must increase) */
+  void datagram_sent( const uint64_t sequence_number, const uint64_t send_time, const uint64_t size );
+
+  /* a datagram's ack arrived at time now; returns whether that
+     produced a new rate sample */
+  bool datagram_acked( const uint64_t sequence_number, const uint64_t now );
+
+  /* the newest rate sample */
+  const RateSample & latest_sample() const { return latest_; }
+
+  /* estimated bottleneck bandwidth, in bytes per second (0 until measured) */
+  double bandwidth() const { return max_bandwidth_.empty() ? 0 : max_bandwidth_.best(); }
+
+  /* estimated propagation RTT, in microseconds (0 until measured) */
+  uint64_t min_rtt_us() const { return min_rtt_.empty() ? 0 : min_rtt_.best(); }
+
+  /* estimated bandwidth-delay product, in bytes and in (average-sized) datagrams */
+  double bdp_bytes() const { return bandwidth() * min_rtt_us() / 1e6; }
+  double bdp_datagrams() const;
+
+  uint64_t round_count() const { return round_count_; }
+};
+
+#endif /* PATH_MODEL_HH */
@@ -2,11 +2,143 @@
 
 #include <cstdlib>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
 
 #include "socket.hh"
 #include "contest_message.hh"
+#include "ack_coalescer.hh"
+#include "io_uring.hh"
+#include "poller.hh"
+#include "timestamp.hh"
+#include "util.hh"
 
 using namespace std;
+using namespace PollerShortNames;
+
+/* the most the command-line options allow */
+static const unsigned int MAX_WORKERS = 1024;
+static const uint64_t MAX_COALESCE_DELAY_US = 1000000;
+
+/* Turn a received datagram into its acknowledgment, in place; the ack is
+   the first ContestMessage::Header::WIRE_SIZE bytes of the datagram */
+static char * make_ack( char * const datagram, const size_t length, const uint64_t timestamp,
+			uint64_t & sequence_number )
+{
+  ContestMessage::Header header( datagram, length );
+
+  header.transform_into_ack( sequence_number++, timestamp,
+			     length - ContestMessage::Header::WIRE_SIZE );
+
+  /* timestamp the ack just before sending */
+  header.set_send_timestamp();
+  header.serialize( datagram );
+
+  return datagram;
+}
+
+/* Loop and acknowledge every incoming datagram back to its source */
+static void serve( UDPSocket & socket )
+{
+  /* each worker numbers its acks independently */
+  uint64_t sequence_number = 0;
+
+  /* datagrams received in one wakeup, left in the socket's buffers
+     and acknowledged in place (storage reused across batches) */
+  vector<UDPSocket::received_view> batch;
+
+  while ( true ) {
+    const size_t count = socket.recv_batch( batch );
+
+    for ( size_t i = 0; i < count; i++ ) {
+      const UDPSocket::received_view & recd = batch[ i ];
+      const char * const ack = make_ack( recd.payload, recd.length, recd.timestamp, sequence_number );
+
+      /* send the ack (just the header; the payload is not echoed) */
+      socket.sendto( *recd.source_address, ack, ContestMessage::Header::WIRE_SIZE );
+    }
+  }
+}
+
+/* The same, through io_uring: one multishot receive keeps delivering
+   datagrams, and the acks queued while handling them are submitted with
+   the next wait, so a wakeup costs one io_uring_enter() however many
+   datagrams it brings */
+static void serve_ring( UDPSocket & socket )
+{
+  uint64_t sequence_number = 0;
+
+  IOUring ring;
+  ring.recv_multishot( socket, [&] ( UDPSocket::received_datagram & recd ) {
+      const char * const ack = make_ack( &recd.payload[ 0 ], recd.payload.size(),
+					 recd.timestamp, sequence_number );
+      ring.sendto( socket, recd.source_address, ack, ContestMessage::Header::WIRE_SIZE );
+    } );
+
+  while ( true ) {
+    ring.wait();
+  }
+}
+
+/* Loop and acknowledge incoming datagrams in groups (see ack_coalescer.hh) */
+static void serve_coalesced( UDPSocket & socket,
+			     const unsigned int max_datagrams,
+			     const uint64_t max_delay_us )
+{
+  AckCoalescer coalescer( socket, max_datagrams, max_delay_us );
+
+  /* datagrams received in one wakeup, left in the socket's buffers
+     (storage reused across batches) */
+  vector<UDPSocket::received_view> batch;
+
+  Poller poller;
+  poller.add_action( Action( socket, Direction::In, [&] () {
+	const size_t count = socket.recv_batch( batch );
+	for ( size_t i = 0; i < count; i++ ) {
+	  coalescer.received( batch[ i ] );
+	}
+	return ResultType::Continue;
+      } ) );
+
+  while ( true ) {
+    /* wait no longer than the oldest unacknowledged datagram may. (The
+       clock's epoch is its first reading, which should line up with the
+       sender's, so it is not read until a datagram has arrived.) */
+    const uint64_t NONE = numeric_limits<uint64_t>::max();
+    const uint64_t deadline = coalescer.next_deadline();
+    int64_t timeout = -1;
+    if ( deadline != NONE ) {
+      const uint64_t now = timestamp_us();
+      timeout = deadline > now ? deadline - now : 0;
+    }
+
+    if ( poller.poll_us( timeout ).result == PollResult::Exit ) {
+      return;
+    }
+
+    if ( coalescer.next_deadline() != NONE ) {
+      coalescer.flush_expired( timestamp_us() );
+    }
+  }
+}
+
+/* restrict the calling thread to one CPU */
+static void pin_to_cpu( const unsigned int cpu )
+{
+  cpu_set_t cpus;
+  CPU_ZERO( &cpus );
+  CPU_SET( cpu, &cpus );
+
+  const int ret = pthread_setaffinity_np( pthread_self(), sizeof( cpus ), &cpus );
+  if ( ret ) {
+    throw unix_error( "pthread_setaffinity_np", ret );
+  }
+}
 
 int main( int argc, char *argv[] )
 {
@@ -15,37 +147,119 @@ int main( int argc, char *argv[] )
     abort();
   }
 
-  if ( argc != 2 ) {
-    cerr << "Usage: " << argv[ 0 ] << " PORT" << endl;
+  if ( argc < 2 ) {
+    cerr << "Usage: " << argv[ 0 ] << " PORT [threads=N] [pin] [coalesce=K:T] [uring]" << endl;
     return EXIT_FAILURE;
   }
 
-  /* create UDP socket for incoming datagrams */
-  UDPSocket socket;
+  const unsigned int cores = max( 1u, thread::hardware_concurrency() );
+  unsigned int worker_count = 1;
+  bool pin = false;
+  bool uring = false;
 
-  /* turn on timestamps on receipt */
-  socket.set_timestamps();
+  /* coalesce=K:T acks up to K datagrams at once, holding none back more than T us */
+  unsigned int coalesce_datagrams = 1;
+  uint64_t coalesce_delay_us = 0;
 
-  /* "bind" the socket to the user-specified local port number */
-  socket.bind( Address( "::0", argv[ 1 ] ) );
+  for ( int i = 2; i < argc; i++ ) {
+    const string arg = argv[ i ];
+    bool valid = true;
+    if ( arg == "pin" ) {
+      pin = true;
+    } else if ( arg == "uring" ) {
+      uring = true;
+    } else if ( arg.substr( 0, 8 ) == "threads=" ) {
+      /* threads=0 means one per core */
+      valid = parse_number( arg.substr( 8 ), worker_count, 0u, MAX_WORKERS );
+      if ( worker_count == 0 ) {
+	worker_count = cores;
+      }
+    } else if ( arg.substr( 0, 9 ) == "coalesce=" and arg.find( ':' ) != string::npos ) {
+      valid = parse_number( arg.substr( 9, arg.find( ':' ) - 9 ), coalesce_datagrams,
+			    1u, CoalescedAck::MAX_DATAGRAMS )
+	and parse_number( arg.substr( arg.find( ':' ) + 1 ), coalesce_delay_us,
+			  uint64_t( 0 ), MAX_COALESCE_DELAY_US );
+    } else {
+      valid = false;
+    }
 
-  cerr << "Listening on " << socket.local_address().to_string() << endl;
+    if ( not valid ) {
+      cerr << "Usage: " << argv[ 0 ] << " PORT [threads=N] [pin] [coalesce=K:T] [uring]" << endl;
+      return EXIT_FAILURE;
+    }
+  }
 
-  uint64_t sequence_number = 0;
+  if ( uring and coalesce_datagrams > 1 ) {
+    cerr << "coalesce and uring cannot be combined" << endl;
+    return EXIT_FAILURE;
+  }
 
-  /* Loop and acknowledge every incoming datagram back to its source */
-  while ( true ) {
-    const UDPSocket::received_datagram recd = socket.recv();
-    ContestMessage message = recd.payload;
+  if ( uring and not IOUring::supported() ) {
+    cerr << "io_uring (with multishot receive) is not available on this system" << endl;
+    return EXIT_FAILURE;
+  }
+
+  /* create UDP sockets for incoming datagrams, one per worker */
+  vector< unique_ptr<UDPSocket> > sockets;
+  for ( unsigned int i = 0; i < worker_count; i++ ) {
+    sockets.emplace_back( new UDPSocket );
+    UDPSocket & socket = *sockets.back();
+
+    /* turn on timestamps on receipt */
+    socket.set_timestamps();
+
+    /* take runs of datagrams from one sender in one buffer, where the kernel can
+       (not through io_uring, whose receive buffers are sized for one datagram) */
+    if ( not uring ) {
+      socket.set_gro();
+    }
 
-    /* assemble the acknowledgment */
-    message.transform_into_ack( sequence_number++, recd.timestamp );
+    /* every worker binds the same port; the kernel spreads flows across them */
+    if ( worker_count > 1 ) {
+      socket.set_reuseport();
+    }
 
-    /* timestamp the ack just before sending */
-    message.set_send_timestamp();
+    /* "bind" the socket to the user-specified local port number */
+    socket.bind( Address( "::0", argv[ 1 ] ) );
+  }
+
+  cerr << "Listening on " << sockets.front()->local_address().to_string();
+  if ( worker_count > 1 ) {
+    cerr << " with " << worker_count << " worker threads";
+  }
+  if ( coalesce_datagrams > 1 ) {
+    cerr << ", coalescing up to " << coalesce_datagrams
+	 << " datagrams per ack (delay at most " << coalesce_delay_us << " us)";
+  }
+  if ( uring ) {
+    cerr << ", through io_uring";
+  }
+  cerr << endl;
+
+  vector<thread> workers;
+  for ( unsigned int i = 0; i < worker_count; i++ ) {
+    UDPSocket & socket = *sockets.at( i );
+    workers.emplace_back( [&socket, i, pin, uring, cores, coalesce_datagrams, coalesce_delay_us] () {
+	try {
+	  if ( pin ) {
+	    pin_to_cpu( i % cores );
+	  }
+	  if ( coalesce_datagrams > 1 ) {
+	    serve_coalesced( socket, coalesce_datagrams, coalesce_delay_us );
+	  } else if ( uring ) {
+	    serve_ring( socket );
+	  } else {
+	    serve( socket );
+	  }
+	} catch ( const exception & e ) {
+	  print_exception( e );
+	  exit( EXIT_FAILURE );
+	}
+      } );
+  }
 
-    /* send the ack */
-    socket.sendto( recd.source_address, message.to_string() );
+  for ( auto & worker : workers ) {
+    worker.join();
   }
 
   return EXIT_SUCCESS;
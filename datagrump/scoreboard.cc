@@ -0,0 +1,131 @@
+#include <algorithm>
+#include <limits>
+
+#include "scoreboard.hh"
+
+using namespace std;
+
+Scoreboard::Scoreboard()
+  : entries_( 1024, { uint64_t( -1 ), 0, 0, 0, State::Acked } ),
+    oldest_( 0 ),
+    next_sequence_number_( 0 ),
+    in_flight_( 0 ),
+    rack_send_time_( 0 ),
+    rack_rtt_( 0 ),
+    min_rtt_( numeric_limits<uint64_t>::max() )
+{}
+
+/* double the ring, keeping every datagram not yet resolved */
+void Scoreboard::grow()
+{
+  vector<Entry> bigger( 2 * entries_.size(), { uint64_t( -1 ), 0, 0, 0, State::Acked } );
+  for ( uint64_t s = oldest_; s < next_sequence_number_; s++ ) {
+    bigger[ s & (bigger.size() - 1) ] = entries_[ s & mask() ];
+  }
+  entries_.swap( bigger );
+}
+
+void Scoreboard::datagram_sent( const uint64_t sequence_number, const uint64_t send_time,
+				const uint32_t size, const uint64_t content )
+{
+  /* anything skipped was never sent */
+  if ( next_sequence_number_ == oldest_ ) {
+    oldest_ = sequence_number;
+  }
+
+  while ( sequence_number - oldest_ >= entries_.size() ) {
+    grow();
+  }
+
+  entries_[ sequence_number & mask() ] = { sequence_number, send_time, content, size, State::InFlight };
+  next_sequence_number_ = sequence_number + 1;
+  in_flight_++;
+}
+
+Scoreboard::Entry * Scoreboard::find( const uint64_t sequence_number )
+{
+  Entry & entry = entries_[ sequence_number & mask() ];
+  return entry.sequence_number == sequence_number ? &entry : nullptr;
+}
+
+bool Scoreboard::datagram_acked( const uint64_t sequence_number, const uint64_t now )
+{
+  Entry * const entry = find( sequence_number );
+  if ( not entry ) {
+    return false; /* outside the window: long since acked or lost, or never sent */
+  } else if ( entry->state == State::Acked ) {
+    return false;
+  }
+
+  if ( entry->state == State::InFlight ) {
+    in_flight_--;
+  }
+  entry->state = State::Acked;
+
+  const uint64_t rtt = now > entry->send_time ? now - entry->send_time : 0;
+  min_rtt_ = min( min_rtt_, rtt );
+
+  /* remember the most recently sent datagram known to be delivered */
+  if ( entry->send_time >= rack_send_time_ ) {
+    rack_send_time_ = entry->send_time;
+    rack_rtt_ = rtt;
+  }
+
+  return true;
+}
+
+bool Scoreboard::datagram_delivered( const uint64_t sequence_number )
+{
+  Entry * const entry = find( sequence_number );
+  if ( not entry or entry->state == State::Acked ) {
+    return false;
+  }
+
+  if ( entry->state == State::InFlight ) {
+    in_flight_--;
+  }
+  entry->state = State::Acked;
+
+  return true;
+}
+
+void Scoreboard::detect_losses( const uint64_t now, const function<void( const Entry & )> & lost )
+{
+  for ( ; oldest_ < next_sequence_number_; oldest_++ ) {
+    Entry & entry = entries_[ oldest_ & mask() ];
+
+    if ( entry.state != State::InFlight ) {
+      continue;
+    }
+
+    /* only datagrams sent before one that got through can be deemed lost,
+       and only once they are a reordering window past the RTT */
+    if ( entry.send_time >= rack_send_time_
+	 or now < entry.send_time + rack_rtt_ + reordering_window() ) {
+      break;
+    }
+
+    entry.state = State::Lost;
+    in_flight_--;
+    lost( entry );
+  }
+
+  /* skip past the delivered datagrams that follow */
+  while ( oldest_ < next_sequence_number_ and entries_[ oldest_ & mask() ].state != State::InFlight ) {
+    oldest_++;
+  }
+}
+
+uint64_t Scoreboard::next_loss_deadline() const
+{
+  if ( oldest_ == next_sequence_number_ ) {
+    return numeric_limits<uint64_t>::max();
+  }
+
+  const Entry & entry = entries_[ oldest_ & mask() ];
+  if ( entry.state != State::InFlight or entry.send_time >= rack_send_time_ ) {
+    return numeric_limits<uint64_t>::max();
+  }
+
+  return entry.send_time + rack_rtt_ + reordering_window();
+}
@@ -0,0 +1,75 @@
+#ifndef SCOREBOARD_HH
+#define SCOREBOARD_HH
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/* What happened to each datagram in flight, in a ring buffer indexed by
+   sequence number. Losses are detected RACK-style (RFC 8985): once a
+   datagram sent later has been acknowledged, a datagram still
+   unacknowledged a reordering window past the RTT is deemed lost.
+   Retransmissions go out under new sequence numbers, so send times
+   never decrease along the ring and detection is a forward scan. */
+
+class Scoreboard
+{
+public:
+  enum class State : uint8_t { InFlight, Acked, Lost };
+
+  struct Entry
+  {
+    uint64_t sequence_number;
+    uint64_t send_time; /* microseconds */
+    uint64_t content; /* sequence number that first carried this datagram's data */
+    uint32_t size;
+    State state;
+  };
+
+private:
+  std::vector<Entry> entries_; /* power-of-two ring; grows when the flight does */
+  uint64_t oldest_; /* every datagram below this is acked or lost */
+  uint64_t next_sequence_number_; /* one past the newest datagram sent */
+  uint64_t in_flight_;
+
+  /* RACK state: the most recently sent datagram known to be delivered */
+  uint64_t rack_send_time_;
+  uint64_t rack_rtt_;
+  uint64_t min_rtt_;
+
+  size_t mask() const { return entries_.size() - 1; }
+  void grow();
+  uint64_t reordering_window() const { return min_rtt_ / 4; }
+
+public:
+  Scoreboard();
+
+  /* a datagram went out (sequence numbers must increase) */
+  void datagram_sent( const uint64_t sequence_number, const uint64_t send_time,
+		      const uint32_t size, const uint64_t content );
+
+  /* its ack arrived; returns false for a duplicate, and for a datagram no
+     longer remembered (whose late or repeated ack can't be told from a
+     first one). A datagram deemed lost but still remembered was delivered
+     after all; it is marked acked. */
+  bool datagram_acked( const uint64_t sequence_number, const uint64_t now );
+
+  /* it is known to have arrived, but not when (so it can't be used to
+     time the path); returns false as datagram_acked() does */
+  bool datagram_delivered( const uint64_t sequence_number );
+
+  /* mark as lost every datagram RACK says is, oldest first,
+     calling lost for each */
+  void detect_losses( const uint64_t now, const std::function<void( const Entry & )> & lost );
+
+  /* when detect_losses() should next be called, if no acks arrive
+     before then (UINT64_MAX if nothing is waiting to be deemed lost) */
+  uint64_t next_loss_deadline() const;
+
+  /* look up a datagram still remembered (nullptr if not) */
+  Entry * find( const uint64_t sequence_number );
+
+  uint64_t in_flight() const { return in_flight_; }
+};
+
+#endif /* SCOREBOARD_HH */
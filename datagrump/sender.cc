@@ -1,22 +1,47 @@
 /* UDP sender for congestion-control contest */
 
 #include <cstdlib>
+#include <cstring>
+#include <deque>
 #include <iostream>
+#include <iomanip>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+#include <endian.h>
 
 #include "socket.hh"
 #include "contest_message.hh"
 #include "controller.hh"
+#include "event_log.hh"
 #include "poller.hh"
+#include "pacer.hh"
+#include "path_model.hh"
+#include "scoreboard.hh"
+#include "timestamp.hh"
+#include "util.hh"
 
 using namespace std;
 using namespace PollerShortNames;
 
-/* simple sender class to handle the accounting */
+/* All messages use the same dummy payload */
+static const size_t DUMMY_PAYLOAD_SIZE = 1424;
+static const size_t DATAGRAM_SIZE = ContestMessage::Header::WIRE_SIZE + DUMMY_PAYLOAD_SIZE;
+
+/* most flows=N allows (each is a socket and a controller) */
+static const unsigned int MAX_FLOWS = 1024;
+
+/* simple sender class to handle the accounting for one flow */
 class DatagrumpSender
 {
 private:
+  unsigned int flow_id_;
   UDPSocket socket_;
-  Controller controller_; /* your class */
+  std::unique_ptr<Controller> controller_; /* chosen with cc=NAME */
+  Pacer pacer_; /* spaces out datagrams at the controller's pacing rate */
+  PathModel path_; /* delivery rate, bandwidth and min-RTT estimates */
 
   uint64_t sequence_number_; /* next outgoing sequence number */
 
@@ -25,16 +50,81 @@ private:
      next expects will be acknowledged by the receiver */
   uint64_t next_ack_expected_;
 
+  /* wire representations of the datagrams in the current batch, back to
+     back (so the kernel can segment them; see UDPSocket::send_segments).
+     The dummy payload is written once; each send only rewrites the header. */
+  std::string batch_;
+
+  /* acks received in one wakeup, left in the socket's buffers
+     (storage reused across batches) */
+  std::vector<UDPSocket::received_view> acks_;
+
+  /* every datagram in flight, with its send time: at first the time
+     the header was written, replaced by the kernel's transmit timestamp
+     once that arrives. Detects losses. */
+  Scoreboard scoreboard_;
+
+  /* In resend mode, lost data is sent again: these are the sequence
+     numbers that first carried data now waiting to be resent. This is
+     only the sender's half of reliable transfer: the receiver acks each
+     datagram as usual and neither reassembles nor deduplicates (each
+     payload is tagged with its data's first sequence number, for a
+     receiver that would). */
+  bool resend_;
+  std::deque<uint64_t> retransmissions_;
+
+  /* transmit timestamps collected in one wakeup (storage reused) */
+  std::vector<UDPSocket::tx_timestamp> tx_timestamps_;
+
+  /* when this flow last had something to do; if nothing happens
+     for the controller's timeout after this, send one datagram */
+  uint64_t last_wakeup_us_;
+
+  /* datagrams acknowledged and lost so far (for the reports) */
+  uint64_t datagrams_acked_;
+  uint64_t datagrams_lost_;
+
+  bool debug_;
+
+  uint64_t prepare_datagram( char * const datagram );
   void send_datagram( const bool after_timeout );
-  void got_ack( const uint64_t timestamp, const ContestMessage & msg );
+  void log_sent( const uint64_t sequence_number, const uint64_t send_timestamp,
+		 const bool after_timeout );
+  void send_window();
+  unsigned int window_space();
+  void got_tx_timestamp( const UDPSocket::tx_timestamp & tx_timestamp );
+  uint64_t send_timestamp( const uint64_t sequence_number, const uint64_t echoed );
+  void got_ack( const uint64_t timestamp, const char * datagram, const size_t length );
+  void datagram_acked( const uint64_t timestamp, const uint64_t sequence_number,
+		       const uint64_t send_timestamp, const uint64_t recv_timestamp );
+  void datagram_delivered( const uint64_t sequence_number );
+  void detect_losses( const uint64_t now );
   bool window_is_open();
 
 public:
   DatagrumpSender( const char * const host, const char * const port,
-		   const bool debug );
-  int loop();
+		   const std::string & algorithm, const bool resend,
+		   const bool debug, const unsigned int flow_id );
+
+  /* register this flow's rules with the (shared) event loop */
+  void add_actions( Poller & poller );
+
+  /* get ready for the next wait: arm the pacer if needed, and return
+     when this flow's controller timeout expires (or, if sooner, when
+     the scoreboard must next look for losses) */
+  uint64_t prepare_to_wait();
+
+  /* after a wait: look for losses, and send a datagram
+     if the controller's timeout expired */
+  void handle_timeout( const uint64_t now_us );
+
+  uint64_t datagrams_acked() const { return datagrams_acked_; }
+  uint64_t datagrams_lost() const { return datagrams_lost_; }
 };
 
+/* run every flow's rules in one event loop */
+static int loop( vector< unique_ptr<DatagrumpSender> > & flows );
+
 int main( int argc, char *argv[] )
 {
    /* check the command-line arguments */
@@ -42,114 +132,473 @@ int main( int argc, char *argv[] )
     abort();
   }
 
-  bool debug = false;
-  if ( argc == 4 and string( argv[ 3 ] ) == "debug" ) {
-    debug = true;
-  } else if ( argc == 3 ) {
-    /* do nothing */
-  } else {
-    cerr << "Usage: " << argv[ 0 ] << " HOST PORT [debug]" << endl;
+  const string usage = string( "Usage: " ) + argv[ 0 ] + " HOST PORT [debug] [flows=N] [cc=NAME] [resend] [log=FILE]\n"
+    + "Congestion-control algorithms:\n" + Controller::describe_all();
+
+  if ( argc < 3 ) {
+    cerr << usage;
     return EXIT_FAILURE;
   }
 
-  /* create sender object to handle the accounting */
-  /* all the interesting work is done by the Controller */
-  DatagrumpSender sender( argv[ 1 ], argv[ 2 ], debug );
-  return sender.loop();
+  bool debug = false, resend = false;
+  unsigned int flow_count = 1;
+  string algorithm = Controller::DEFAULT_NAME;
+
+  for ( int i = 3; i < argc; i++ ) {
+    const string arg = argv[ i ];
+    if ( arg == "debug" ) {
+      debug = true;
+    } else if ( arg == "resend" ) {
+      /* resend lost data (see DatagrumpSender::resend_) */
+      resend = true;
+    } else if ( arg.substr( 0, 6 ) == "flows=" ) {
+      if ( not parse_number( arg.substr( 6 ), flow_count, 1u, MAX_FLOWS ) ) {
+	cerr << usage;
+	return EXIT_FAILURE;
+      }
+    } else if ( arg.substr( 0, 3 ) == "cc=" and Controller::exists( arg.substr( 3 ) ) ) {
+      algorithm = arg.substr( 3 );
+    } else if ( arg.substr( 0, 4 ) == "log=" and arg.size() > 4 ) {
+      /* binary event log of sends, acks, losses and controller state (see decode-log) */
+      EventLog::open( arg.substr( 4 ) );
+    } else {
+      cerr << usage;
+      return EXIT_FAILURE;
+    }
+  }
+
+  /* create sender objects to handle the accounting, one per flow */
+  /* all the interesting work is done by the Controllers */
+  vector< unique_ptr<DatagrumpSender> > flows;
+  for ( unsigned int i = 0; i < flow_count; i++ ) {
+    flows.emplace_back( new DatagrumpSender( argv[ 1 ], argv[ 2 ], algorithm, resend, debug, i ) );
+  }
+
+  const int status = loop( flows );
+
+  /* (reports a failure to write the event log, if there was one) */
+  EventLog::close();
+  return status;
 }
 
 DatagrumpSender::DatagrumpSender( const char * const host,
 				  const char * const port,
-				  const bool debug )
-  : socket_(),
-    controller_( debug ),
+				  const string & algorithm,
+				  const bool resend,
+				  const bool debug,
+				  const unsigned int flow_id )
+  : flow_id_( flow_id ),
+    socket_(),
+    controller_( Controller::make( algorithm, debug ) ),
+    pacer_(),
+    path_(),
     sequence_number_( 0 ),
-    next_ack_expected_( 0 )
+    next_ack_expected_( 0 ),
+    batch_( UDPSocket::BATCH_SIZE * DATAGRAM_SIZE, 'x' ),
+    acks_(),
+    scoreboard_(),
+    resend_( resend ),
+    retransmissions_(),
+    tx_timestamps_(),
+    last_wakeup_us_( timestamp_us() ),
+    datagrams_acked_( 0 ),
+    datagrams_lost_( 0 ),
+    debug_( debug )
 {
+  controller_->set_flow_id( flow_id_ );
+
   /* turn on timestamps when socket receives a datagram */
   socket_.set_timestamps();
 
+  /* and when the kernel sends one, so RTTs don't include our own queueing */
+  socket_.set_tx_timestamps();
+
+  /* let the kernel split each batch into datagrams, and join acks, where it can */
+  socket_.set_gso();
+  socket_.set_gro();
+
   /* connect socket to the remote host */
   /* (note: this doesn't send anything; it just tags the socket
      locally with the remote address */
   socket_.connect( Address( host, port ) );  
 
-  cerr << "Sending to " << socket_.peer_address().to_string() << endl;
+  cerr << "Sending to " << socket_.peer_address().to_string()
+       << " (flow " << flow_id_ << " using " << algorithm << ", from " << socket_.local_address().to_string() << ")" << endl;
 }
 
 void DatagrumpSender::got_ack( const uint64_t timestamp,
-			       const ContestMessage & ack )
+			       const char * const datagram, const size_t length )
 {
+  const ContestMessage::Header ack( datagram, length );
+
   if ( not ack.is_ack() ) {
     throw runtime_error( "sender got something other than an ack from the receiver" );
   }
 
-  /* Update sender's counter */
+  /* a plain ack is just the header */
+  if ( length == ContestMessage::Header::WIRE_SIZE ) {
+    datagram_acked( timestamp, ack.ack_sequence_number,
+		    send_timestamp( ack.ack_sequence_number, ack.ack_send_timestamp ),
+		    ack.ack_recv_timestamp );
+    return;
+  }
+
+  /* a coalesced ack covers several datagrams; report them oldest first */
+  const CoalescedAck trailer( datagram + ContestMessage::Header::WIRE_SIZE,
+			      length - ContestMessage::Header::WIRE_SIZE );
+
+  for ( int i = CoalescedAck::MAX_DATAGRAMS - 1; i > 0; i-- ) {
+    const uint64_t sequence_number = ack.ack_sequence_number - i;
+    const Scoreboard::Entry * const sent = scoreboard_.find( sequence_number );
+    if ( not (trailer.bitmap & (uint64_t( 1 ) << i)) or not sent ) {
+      continue; /* not covered, or too old to remember when it was sent */
+    }
+
+    datagram_acked( timestamp, sequence_number, sent->send_time,
+		    ack.ack_recv_timestamp - trailer.recv_offsets[ i ] );
+  }
+
+  datagram_acked( timestamp, ack.ack_sequence_number,
+		  send_timestamp( ack.ack_sequence_number, ack.ack_send_timestamp ),
+		  ack.ack_recv_timestamp );
+
+  /* the trailer also repeats recent arrivals, in case an earlier ack was lost */
+  for ( uint64_t i = 1; i < CoalescedAck::HISTORY and i <= ack.ack_sequence_number; i++ ) {
+    if ( trailer.arrived[ i / 64 ] & (uint64_t( 1 ) << (i % 64)) ) {
+      datagram_delivered( ack.ack_sequence_number - i );
+    }
+  }
+}
+
+/* best known send time of a datagram: the kernel's, if it is still
+   remembered, otherwise the one echoed back in the ack */
+uint64_t DatagrumpSender::send_timestamp( const uint64_t sequence_number,
+					  const uint64_t echoed )
+{
+  const Scoreboard::Entry * const sent = scoreboard_.find( sequence_number );
+  return sent ? sent->send_time : echoed;
+}
+
+/* the kernel has reported when a datagram actually went out */
+void DatagrumpSender::got_tx_timestamp( const UDPSocket::tx_timestamp & tx_timestamp )
+{
+  /* only datagrams go out on this socket, so the socket's
+     count of datagrams sent is the sequence number */
+  for ( uint64_t sequence_number = tx_timestamp.first_datagram;
+	sequence_number < tx_timestamp.first_datagram + tx_timestamp.datagram_count;
+	sequence_number++ ) {
+    Scoreboard::Entry * const sent = scoreboard_.find( sequence_number );
+    if ( sent ) {
+      sent->send_time = tx_timestamp.timestamp;
+    }
+  }
+}
+
+void DatagrumpSender::datagram_acked( const uint64_t timestamp,
+				      const uint64_t sequence_number,
+				      const uint64_t send_timestamp,
+				      const uint64_t recv_timestamp )
+{
+  /* ignore duplicates */
+  if ( not scoreboard_.datagram_acked( sequence_number, timestamp ) ) {
+    return;
+  }
+
+  /* Update sender's counters */
   next_ack_expected_ = max( next_ack_expected_,
-			    ack.header.ack_sequence_number + 1 );
+			    sequence_number + 1 );
+  datagrams_acked_++;
 
   /* Inform congestion controller */
-  controller_.ack_received( ack.header.ack_sequence_number,
-			    ack.header.ack_send_timestamp,
-			    ack.header.ack_recv_timestamp,
+  controller_->ack_received( sequence_number,
+			    send_timestamp,
+			    recv_timestamp,
 			    timestamp );
+
+  EventLog::log( EventLog::Type::Acked, timestamp, flow_id_, 0, sequence_number,
+		 timestamp - send_timestamp, send_timestamp, recv_timestamp,
+		 controller_->window_size() );
+
+  /* and update the path model (and the controller, if it learned something new) */
+  if ( path_.datagram_acked( sequence_number, timestamp ) ) {
+    controller_->path_measured( path_ );
+  }
 }
 
-void DatagrumpSender::send_datagram( const bool after_timeout )
+/* a datagram arrived, but its ack (and receive time) was lost: count it
+   as delivered so it isn't deemed lost, without telling the controller */
+void DatagrumpSender::datagram_delivered( const uint64_t sequence_number )
+{
+  if ( not scoreboard_.datagram_delivered( sequence_number ) ) {
+    return;
+  }
+
+  next_ack_expected_ = max( next_ack_expected_,
+			    sequence_number + 1 );
+  datagrams_acked_++;
+}
+
+/* mark what RACK says is lost, and tell the controller */
+void DatagrumpSender::detect_losses( const uint64_t now )
 {
-  /* All messages use the same dummy payload */
-  static const string dummy_payload( 1424, 'x' );
+  scoreboard_.detect_losses( now, [&] ( const Scoreboard::Entry & lost ) {
+      datagrams_lost_++;
+      controller_->packet_lost( lost.sequence_number, lost.send_time );
+      EventLog::log( EventLog::Type::Lost, now, flow_id_, 0, lost.sequence_number,
+		     lost.send_time );
 
-  ContestMessage cm( sequence_number_++, dummy_payload );
-  cm.set_send_timestamp();
-  socket_.send( cm.to_string() );
+      if ( resend_ ) {
+	retransmissions_.push_back( lost.content );
+      }
+
+      if ( debug_ ) {
+	cerr << "At time " << now << " datagram " << lost.sequence_number
+	     << " (sent at " << lost.send_time << ") deemed lost" << endl;
+      }
+    } );
+}
+
+/* write the header for the next outgoing datagram in place,
+   returning its send timestamp */
+uint64_t DatagrumpSender::prepare_datagram( char * const datagram )
+{
+  ContestMessage::Header header( sequence_number_++ );
+  header.set_send_timestamp();
+  header.serialize( datagram );
+
+  /* in resend mode, lost data goes first; the payload starts
+     with the sequence number that first carried it */
+  uint64_t content = header.sequence_number;
+  if ( resend_ ) {
+    if ( not retransmissions_.empty() ) {
+      content = retransmissions_.front();
+      retransmissions_.pop_front();
+    }
+    const uint64_t network_order = htobe64( content );
+    memcpy( datagram + ContestMessage::Header::WIRE_SIZE, &network_order, sizeof( network_order ) );
+  }
+
+  scoreboard_.datagram_sent( header.sequence_number, header.send_timestamp, DATAGRAM_SIZE, content );
+  path_.datagram_sent( header.sequence_number, header.send_timestamp, DATAGRAM_SIZE );
+  return header.send_timestamp;
+}
+
+void DatagrumpSender::send_datagram( const bool after_timeout )
+{
+  const uint64_t sequence_number = sequence_number_;
+  const uint64_t send_timestamp = prepare_datagram( &batch_[ 0 ] );
+  socket_.send_segments( batch_.data(), DATAGRAM_SIZE, 1 );
 
   /* Inform congestion controller */
-  controller_.datagram_was_sent( cm.header.sequence_number,
-				 cm.header.send_timestamp,
+  controller_->datagram_was_sent( sequence_number,
+				 send_timestamp,
 				 after_timeout );
+  log_sent( sequence_number, send_timestamp, after_timeout );
 }
 
-bool DatagrumpSender::window_is_open()
+/* record a send in the event log, with what the controller now says */
+void DatagrumpSender::log_sent( const uint64_t sequence_number,
+				const uint64_t send_timestamp,
+				const bool after_timeout )
 {
-  return sequence_number_ - next_ack_expected_ < controller_.window_size();
+  if ( EventLog::enabled() ) {
+    EventLog::log( EventLog::Type::Sent, send_timestamp, flow_id_, after_timeout, sequence_number,
+		   controller_->window_size(), controller_->timeout_us(),
+		   controller_->pacing_rate() );
+  }
 }
 
-int DatagrumpSender::loop()
+/* send everything the window and the pacer allow, one sendmmsg() per batch */
+void DatagrumpSender::send_window()
 {
-  /* read and write from the receiver using an event-driven "poller" */
-  Poller poller;
+  uint64_t send_timestamps[ UDPSocket::BATCH_SIZE ];
+
+  while ( window_is_open() ) {
+    pacer_.set_rate( controller_->pacing_rate() );
+
+    /* spin out short waits; leave longer ones to the pacer's timer */
+    uint64_t now = timestamp_ns();
+    const uint64_t wait = pacer_.wait_ns( now );
+    if ( wait > Pacer::SPIN_NS ) {
+      break;
+    } else if ( wait > 0 ) {
+      now = pacer_.spin();
+    }
+
+    const unsigned int count = min( min( window_space(), UDPSocket::BATCH_SIZE ),
+				    pacer_.allowance( now ) );
+    const uint64_t first_sequence_number = sequence_number_;
+
+    /* each datagram carries its own send timestamp */
+    for ( unsigned int i = 0; i < count; i++ ) {
+      send_timestamps[ i ] = prepare_datagram( &batch_[ i * DATAGRAM_SIZE ] );
+    }
+
+    socket_.send_segments( batch_.data(), DATAGRAM_SIZE, count );
+    pacer_.released( now, count );
+
+    /* Inform congestion controller about each datagram, in order */
+    for ( unsigned int i = 0; i < count; i++ ) {
+      controller_->datagram_was_sent( first_sequence_number + i,
+				     send_timestamps[ i ],
+				     false );
+      log_sent( first_sequence_number + i, send_timestamps[ i ], false );
+    }
+  }
+}
+
+/* how many more datagrams the window has room for */
+unsigned int DatagrumpSender::window_space()
+{
+  const uint64_t in_flight = sequence_number_ - next_ack_expected_;
+  const unsigned int window = controller_->window_size();
+  return in_flight < window ? window - in_flight : 0;
+}
+
+bool DatagrumpSender::window_is_open()
+{
+  return window_space() > 0;
+}
 
+void DatagrumpSender::add_actions( Poller & poller )
+{
   /* first rule: if the window is open, close it by
-     sending more datagrams */
+     sending more datagrams (as fast as the pacer allows) */
   poller.add_action( Action( socket_, Direction::Out, [&] () {
+	last_wakeup_us_ = timestamp_us();
+
 	/* Close the window */
-	while ( window_is_open() ) {
-	  send_datagram( false );
-	}
+	send_window();
+	return ResultType::Continue;
+      },
+      /* We're only interested in this rule when the window is open
+	 and the pacer isn't holding the next datagram back */
+      [&] () { return window_is_open() and not pacer_.scheduled(); } ) );
+
+  /* second rule: when the pacer's timer fires, release what is due */
+  poller.add_action( Action( pacer_.timer(), Direction::In, [&] () {
+	last_wakeup_us_ = timestamp_us();
+	pacer_.timer().read_expirations();
+	send_window();
 	return ResultType::Continue;
       },
-      /* We're only interested in this rule when the window is open */
-      [&] () { return window_is_open(); } ) );
+      [&] () { return pacer_.scheduled(); } ) );
+
+  /* third rule: record the kernel's transmit timestamps (queued on
+     the socket's error queue) before the acks that will need them */
+  poller.add_action( Action( socket_, Direction::Err, [&] () {
+	const size_t count = socket_.recv_tx_timestamps( tx_timestamps_ );
+	for ( size_t i = 0; i < count; i++ ) {
+	  got_tx_timestamp( tx_timestamps_[ i ] );
+	}
+	return ResultType::Continue;
+      } ) );
 
-  /* second rule: if sender receives an ack,
+  /* fourth rule: if sender receives an ack,
      process it and inform the controller
-     (by using the sender's got_ack method) */
+     (by using the sender's got_ack method).
+     Every ack already queued is handled in the same wakeup. */
   poller.add_action( Action( socket_, Direction::In, [&] () {
-	const UDPSocket::received_datagram recd = socket_.recv();
-	const ContestMessage ack  = recd.payload;
-	got_ack( recd.timestamp, ack );
+	last_wakeup_us_ = timestamp_us();
+	const size_t count = socket_.recv_batch( acks_ );
+	for ( size_t i = 0; i < count; i++ ) {
+	  got_ack( acks_[ i ].timestamp, acks_[ i ].payload, acks_[ i ].length );
+	}
+	detect_losses( last_wakeup_us_ );
 	return ResultType::Continue;
       } ) );
+}
+
+uint64_t DatagrumpSender::prepare_to_wait()
+{
+  /* if the window is open but the next datagram isn't due yet,
+     set the pacer's timer */
+  if ( window_is_open() ) {
+    pacer_.set_rate( controller_->pacing_rate() );
+    pacer_.schedule( timestamp_ns() );
+  }
+
+  return min( last_wakeup_us_ + controller_->timeout_us(),
+	      scoreboard_.next_loss_deadline() );
+}
+
+void DatagrumpSender::handle_timeout( const uint64_t now_us )
+{
+  detect_losses( now_us );
+
+  if ( now_us >= last_wakeup_us_ + controller_->timeout_us() ) {
+    /* After a timeout, send one datagram to try to get things moving again */
+    last_wakeup_us_ = now_us;
+    send_datagram( true );
+  }
+}
+
+/* Jain's fairness index: 1 when all flows get the same share, 1/n when one gets everything */
+static double jain_index( const vector<double> & shares )
+{
+  double sum = 0, sum_of_squares = 0;
+  for ( const auto & x : shares ) {
+    sum += x;
+    sum_of_squares += x * x;
+  }
 
-  /* Run these two rules forever */
+  return sum_of_squares > 0 ? sum * sum / (shares.size() * sum_of_squares) : 1;
+}
+
+static int loop( vector< unique_ptr<DatagrumpSender> > & flows )
+{
+  /* read and write from the receiver using an event-driven "poller" */
+  Poller poller;
+
+  for ( auto & flow : flows ) {
+    flow->add_actions( poller );
+  }
+
+  /* with several flows, report how they share the path once a second */
+  const uint64_t REPORT_INTERVAL_US = 1000000;
+  uint64_t next_report = timestamp_us() + REPORT_INTERVAL_US;
+  vector<uint64_t> acked_at_last_report( flows.size(), 0 );
+  vector<double> throughputs( flows.size() );
+
+  /* Run these rules forever */
   while ( true ) {
-    const auto ret = poller.poll( controller_.timeout_ms() );
+    /* wait no longer than the earliest controller timeout */
+    uint64_t deadline = flows.size() > 1 ? next_report : numeric_limits<uint64_t>::max();
+    for ( auto & flow : flows ) {
+      deadline = min( deadline, flow->prepare_to_wait() );
+    }
+
+    const uint64_t before = timestamp_us();
+    const auto ret = poller.poll_us( deadline > before ? deadline - before : 0 );
     if ( ret.result == PollResult::Exit ) {
       return ret.exit_status;
-    } else if ( ret.result == PollResult::Timeout ) {
-      /* After a timeout, send one datagram to try to get things moving again */
-      send_datagram( true );
+    }
+
+    const uint64_t now = timestamp_us();
+    for ( auto & flow : flows ) {
+      flow->handle_timeout( now );
+    }
+
+    if ( flows.size() > 1 and now >= next_report ) {
+      const double seconds = (now - next_report + REPORT_INTERVAL_US) / 1e6;
+      double total = 0;
+      uint64_t lost = 0;
+      for ( unsigned int i = 0; i < flows.size(); i++ ) {
+	lost += flows[ i ]->datagrams_lost();
+	const uint64_t acked = flows[ i ]->datagrams_acked();
+	throughputs[ i ] = (acked - acked_at_last_report[ i ]) * DATAGRAM_SIZE
+	  * 8 / seconds / 1e6;
+	acked_at_last_report[ i ] = acked;
+	total += throughputs[ i ];
+      }
+
+      ostringstream report;
+      report << fixed << setprecision( 3 ) << "At time " << now / 1e6 << " s: aggregate throughput "
+	     << total << " Mbits/s over " << flows.size() << " flows, Jain's fairness index "
+	     << jain_index( throughputs ) << ", " << lost << " datagrams lost so far";
+      cerr << report.str() << endl;
+
+      next_report = now + REPORT_INTERVAL_US;
     }
   }
 }
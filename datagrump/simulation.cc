@@ -0,0 +1,320 @@
+#include <algorithm>
+#include <deque>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+#include "simulation.hh"
+#include "path_model.hh"
+#include "scoreboard.hh"
+#include "event_log.hh"
+#include "link_stats.hh"
+
+using namespace std;
+
+/* sizes on the wire, including the 28 bytes of IPv4 and UDP headers */
+static const uint64_t DATAGRAM_BYTES = 1500; /* 48-byte header + 1424-byte dummy payload */
+static const uint64_t ACK_BYTES = 76; /* header only */
+
+/* mahimahi delivers up to one MTU per opportunity */
+static const uint64_t OPPORTUNITY_BYTES = 1504;
+
+static const uint64_t NEVER = numeric_limits<uint64_t>::max();
+
+/* load a trace file */
+LinkTrace LinkTrace::load( const string & filename )
+{
+  ifstream file( filename );
+  if ( not file.is_open() ) {
+    throw runtime_error( "could not open trace " + filename );
+  }
+
+  LinkTrace trace;
+  uint64_t ms;
+  while ( file >> ms ) {
+    if ( not trace.opportunities_us.empty() and ms * 1000 < trace.opportunities_us.back() ) {
+      throw runtime_error( filename + ": timestamps must not decrease" );
+    }
+    trace.opportunities_us.push_back( ms * 1000 );
+  }
+
+  if ( not file.eof() ) {
+    throw runtime_error( filename + ": not a mahimahi trace" );
+  }
+
+  if ( trace.opportunities_us.empty() or trace.opportunities_us.back() == 0 ) {
+    throw runtime_error( filename + ": trace must last at least one millisecond" );
+  }
+
+  trace.period_us = trace.opportunities_us.back();
+  return trace;
+}
+
+namespace {
+  struct Packet
+  {
+    uint64_t size;
+    uint64_t enqueue_time;
+
+    /* contest header fields that matter to the controller */
+    uint64_t sequence_number;
+    uint64_t send_timestamp;
+    uint64_t recv_timestamp;
+  };
+
+  /* packets crossing a fixed propagation delay, in arrival order */
+  class DelayLine
+  {
+  private:
+    uint64_t delay_;
+    deque< pair<uint64_t, Packet> > packets_;
+
+  public:
+    DelayLine( const uint64_t delay ) : delay_( delay ), packets_() {}
+
+    void push( const uint64_t now, const Packet & packet ) { packets_.emplace_back( now + delay_, packet ); }
+    uint64_t next_arrival() const { return packets_.empty() ? NEVER : packets_.front().first; }
+    Packet pop() { const Packet ret = packets_.front().second; packets_.pop_front(); return ret; }
+  };
+
+  /* a mahimahi-style link: a droptail queue drained at the trace's
+     delivery opportunities. Without a trace, packets pass straight through. */
+  class TraceLink
+  {
+  private:
+    const LinkTrace & trace_;
+    size_t index_; /* next opportunity within the current pass */
+    uint64_t pass_start_; /* when the current pass through the trace began */
+    unsigned int limit_;
+    deque<Packet> queue_;
+
+    uint64_t opportunity() const { return pass_start_ + trace_.opportunities_us[ index_ ]; }
+
+    void advance()
+    {
+      if ( ++index_ == trace_.opportunities_us.size() ) {
+	index_ = 0;
+	pass_start_ += trace_.period_us;
+      }
+    }
+
+  public:
+    TraceLink( const LinkTrace & trace, const unsigned int limit )
+      : trace_( trace ), index_( 0 ), pass_start_( 0 ), limit_( limit ), queue_() {}
+
+    bool passthrough() const { return trace_.opportunities_us.empty(); }
+
+    /* returns false if the packet was dropped */
+    bool enqueue( const uint64_t now, Packet packet )
+    {
+      if ( limit_ and queue_.size() >= limit_ ) {
+	return false;
+      }
+
+      /* an idle link lets opportunities go by unused */
+      if ( queue_.empty() ) {
+	while ( opportunity() < now ) {
+	  advance();
+	}
+      }
+
+      packet.enqueue_time = now;
+      queue_.push_back( packet );
+      return true;
+    }
+
+    uint64_t next_delivery() const { return queue_.empty() ? NEVER : opportunity(); }
+
+    /* use the next delivery opportunity */
+    template <typename Callback>
+    void deliver( const Callback & delivered )
+    {
+      uint64_t budget = OPPORTUNITY_BYTES;
+      while ( not queue_.empty() and queue_.front().size <= budget ) {
+	budget -= queue_.front().size;
+	delivered( queue_.front() );
+	queue_.pop_front();
+      }
+      advance();
+    }
+  };
+}
+
+/* drive controller through the modeled path */
+SimulationResult simulate( const SimulationConfig & config, Controller & controller )
+{
+  const uint64_t end = config.duration_us ? config.duration_us : config.uplink.period_us;
+
+  TraceLink uplink( config.uplink, config.queue_limit_packets );
+  TraceLink downlink( config.downlink, 0 );
+  DelayLine to_receiver( config.one_way_delay_us ), to_sender( config.one_way_delay_us );
+
+  SimulationResult result;
+  vector<uint64_t> delays;
+  SignalDelay signal_delay;
+
+  /* sender state, as in DatagrumpSender */
+  uint64_t sequence_number = 0, next_ack_expected = 0;
+  PathModel path;
+  Scoreboard scoreboard;
+  uint64_t next_release = 0; /* pacer */
+  uint64_t now = 0;
+
+  /* the receiver's clock starts at its first arrival, which it reads as
+     that datagram's send time (the real endpoints' clocks are only
+     aligned by when each process first reads its own) */
+  bool receiver_clock_started = false;
+  uint64_t receiver_clock_offset = 0;
+
+  auto window_space = [&] () -> uint64_t {
+    const uint64_t in_flight = sequence_number - next_ack_expected;
+    const unsigned int window = controller.window_size();
+    return in_flight < window ? window - in_flight : 0;
+  };
+
+  auto send_datagram = [&] ( const bool after_timeout ) {
+    const Packet packet = { DATAGRAM_BYTES, 0, sequence_number++, now, 0 };
+    result.datagrams_sent++;
+    if ( not uplink.enqueue( now, packet ) ) {
+      result.datagrams_dropped++;
+    }
+    scoreboard.datagram_sent( packet.sequence_number, now, DATAGRAM_BYTES, packet.sequence_number );
+    path.datagram_sent( packet.sequence_number, now, DATAGRAM_BYTES );
+    controller.datagram_was_sent( packet.sequence_number, now, after_timeout );
+    if ( EventLog::enabled() ) {
+      EventLog::log( EventLog::Type::Sent, now, 0, after_timeout, packet.sequence_number,
+		     controller.window_size(), controller.timeout_us(), controller.pacing_rate() );
+    }
+  };
+
+  /* returns true if the window is still open and nothing is holding it back
+     (the real sender would be woken again right away by the writable socket) */
+  auto send_window = [&] () -> bool {
+    for ( unsigned int batch = 0; batch < 64; batch++ ) {
+      if ( window_space() == 0 ) {
+	return false;
+      }
+
+      const double rate = controller.pacing_rate();
+      if ( rate > 0 ) {
+	if ( next_release > now ) {
+	  return false;
+	}
+	next_release = max( next_release, now ) + uint64_t( 1e6 / rate );
+      }
+
+      send_datagram( false );
+    }
+    return window_space() > 0;
+  };
+
+  auto detect_losses = [&] () {
+    scoreboard.detect_losses( now, [&] ( const Scoreboard::Entry & lost ) {
+	controller.packet_lost( lost.sequence_number, lost.send_time );
+	EventLog::log( EventLog::Type::Lost, now, 0, 0, lost.sequence_number, lost.send_time );
+      } );
+  };
+
+  auto receive_ack = [&] ( const Packet & ack ) {
+    if ( not scoreboard.datagram_acked( ack.sequence_number, now ) ) {
+      return;
+    }
+    next_ack_expected = max( next_ack_expected, ack.sequence_number + 1 );
+    controller.ack_received( ack.sequence_number, ack.send_timestamp,
+			     ack.recv_timestamp, now );
+    EventLog::log( EventLog::Type::Acked, now, 0, 0, ack.sequence_number,
+		   now - ack.send_timestamp, ack.send_timestamp, ack.recv_timestamp,
+		   controller.window_size() );
+    if ( path.datagram_acked( ack.sequence_number, now ) ) {
+      controller.path_measured( path );
+    }
+  };
+
+  bool writable = send_window();
+  uint64_t timeout_deadline = now + controller.timeout_us();
+
+  while ( true ) {
+    /* find the next event */
+    uint64_t next = min( min( uplink.next_delivery(), to_receiver.next_arrival() ),
+			 min( to_sender.next_arrival(), downlink.next_delivery() ) );
+    next = min( next, min( timeout_deadline, scoreboard.next_loss_deadline() ) );
+    if ( window_space() > 0 and next_release > now ) {
+      next = min( next, next_release );
+    }
+    if ( writable ) {
+      next = min( next, now + 1 );
+    }
+
+    if ( next >= end ) {
+      break;
+    }
+
+    now = next;
+    bool sender_woke = writable or (now == next_release);
+
+    /* the bottleneck link delivers datagrams toward the receiver */
+    while ( uplink.next_delivery() == now ) {
+      uplink.deliver( [&] ( const Packet & packet ) {
+	  result.datagrams_delivered++;
+	  delays.push_back( now - packet.enqueue_time );
+	  signal_delay.add( packet.enqueue_time, now );
+	  to_receiver.push( now, packet );
+	} );
+    }
+
+    /* the receiver acknowledges each datagram as it arrives */
+    while ( to_receiver.next_arrival() == now ) {
+      Packet ack = to_receiver.pop();
+      ack.size = ACK_BYTES;
+      if ( not receiver_clock_started ) {
+	receiver_clock_started = true;
+	receiver_clock_offset = now - ack.send_timestamp;
+      }
+      ack.recv_timestamp = now - receiver_clock_offset;
+      if ( downlink.passthrough() ) {
+	to_sender.push( now, ack );
+      } else {
+	downlink.enqueue( now, ack );
+      }
+    }
+
+    while ( downlink.next_delivery() == now ) {
+      downlink.deliver( [&] ( const Packet & ack ) { to_sender.push( now, ack ); } );
+    }
+
+    /* acks reach the sender */
+    while ( to_sender.next_arrival() == now ) {
+      receive_ack( to_sender.pop() );
+      sender_woke = true;
+    }
+
+    detect_losses();
+
+    if ( not sender_woke and now >= timeout_deadline ) {
+      /* After a timeout, send one datagram to try to get things moving again */
+      send_datagram( true );
+      sender_woke = true;
+    }
+
+    if ( sender_woke ) {
+      writable = send_window();
+      timeout_deadline = now + controller.timeout_us();
+    }
+  }
+
+  /* summarize what the link carried */
+  uint64_t opportunities = 0;
+  for ( uint64_t pass = 0; pass < end; pass += config.uplink.period_us ) {
+    for ( const auto & t : config.uplink.opportunities_us ) {
+      opportunities += (pass + t < end);
+    }
+  }
+
+  result.duration_s = end / 1e6;
+  result.capacity_mbps = opportunities * OPPORTUNITY_BYTES * 8 / double( end );
+  result.throughput_mbps = result.datagrams_delivered * DATAGRAM_BYTES * 8 / double( end );
+  result.delay_p95_ms = percentile_95( delays ) / 1000.0;
+  result.signal_delay_p95_ms = signal_delay.p95_ms();
+
+  return result;
+}
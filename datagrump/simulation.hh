@@ -0,0 +1,66 @@
+#ifndef SIMULATION_HH
+#define SIMULATION_HH
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "controller.hh"
+
+/* Trace-driven model of the contest's network path (the sender's uplink
+   through mm-link, then mm-delay), run on a virtual clock so a Controller
+   can be evaluated much faster than real time. */
+
+/* packet-delivery opportunities from a mahimahi trace file
+   (one line per opportunity, in milliseconds; the trace repeats) */
+struct LinkTrace
+{
+  std::vector<uint64_t> opportunities_us;
+  uint64_t period_us;
+
+  LinkTrace() : opportunities_us(), period_us( 0 ) {}
+
+  /* load a trace file */
+  static LinkTrace load( const std::string & filename );
+};
+
+struct SimulationConfig
+{
+  LinkTrace uplink;
+  LinkTrace downlink; /* empty: acks only see the propagation delay */
+  uint64_t one_way_delay_us;
+  uint64_t duration_us;
+  unsigned int queue_limit_packets; /* droptail limit, 0 for unlimited (mahimahi's default) */
+
+  /* the most the command-line options allow */
+  static const uint64_t MAX_DELAY_MS = 60000;
+  static constexpr double MAX_DURATION_S = 1e6;
+
+  SimulationConfig()
+    : uplink(), downlink(), one_way_delay_us( 20000 ),
+      duration_us( 0 ), queue_limit_packets( 0 ) {}
+};
+
+struct SimulationResult
+{
+  double duration_s;
+  double capacity_mbps;
+  double throughput_mbps;
+  double delay_p95_ms; /* 95th percentile per-packet delay through the link */
+  double signal_delay_p95_ms; /* 95th percentile signal delay */
+  uint64_t datagrams_sent, datagrams_delivered, datagrams_dropped;
+
+  SimulationResult()
+    : duration_s( 0 ), capacity_mbps( 0 ), throughput_mbps( 0 ),
+      delay_p95_ms( 0 ), signal_delay_p95_ms( 0 ),
+      datagrams_sent( 0 ), datagrams_delivered( 0 ), datagrams_dropped( 0 ) {}
+
+  /* throughput over delay, the contest's figure of merit */
+  double power() const { return throughput_mbps / (signal_delay_p95_ms / 1000.0); }
+};
+
+/* drive controller through the modeled path until config.duration_us
+   (or one pass through the uplink trace) of virtual time has elapsed */
+SimulationResult simulate( const SimulationConfig & config, Controller & controller );
+
+#endif /* SIMULATION_HH */
@@ -0,0 +1,97 @@
+/* run the congestion controller against a mahimahi trace on a virtual clock */
+
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <iomanip>
+#include <memory>
+
+#include "controller.hh"
+#include "simulation.hh"
+#include "event_log.hh"
+#include "util.hh"
+
+using namespace std;
+
+int main( int argc, char *argv[] )
+{
+   /* check the command-line arguments */
+  if ( argc < 1 ) { /* for sticklers */
+    abort();
+  }
+
+  if ( argc < 2 ) {
+    cerr << "Usage: " << argv[ 0 ] << " UPLINK-TRACE [downlink=TRACE] [delay=MS] [queue=PACKETS] [duration=S] [seed=N] [cc=NAME] [log=FILE] [debug]" << endl
+	 << "Congestion-control algorithms:" << endl << Controller::describe_all();
+    return EXIT_FAILURE;
+  }
+
+  SimulationConfig config;
+  config.uplink = LinkTrace::load( argv[ 1 ] );
+
+  bool debug = false;
+  unsigned int seed = 0;
+  string algorithm = Controller::DEFAULT_NAME;
+
+  for ( int i = 2; i < argc; i++ ) {
+    const string arg = argv[ i ];
+    const string::size_type equals = arg.find( '=' );
+    const string key = arg.substr( 0, equals );
+    const string value = equals == string::npos ? "" : arg.substr( equals + 1 );
+    bool valid = true;
+    uint64_t delay_ms = 0;
+    double duration_s = 0;
+
+    if ( arg == "debug" ) {
+      debug = true;
+    } else if ( key == "downlink" ) {
+      config.downlink = LinkTrace::load( value );
+    } else if ( key == "delay" ) {
+      valid = parse_number( value, delay_ms, uint64_t( 0 ), SimulationConfig::MAX_DELAY_MS );
+      config.one_way_delay_us = delay_ms * 1000;
+    } else if ( key == "queue" ) {
+      valid = parse_number( value, config.queue_limit_packets, 0u );
+    } else if ( key == "duration" ) {
+      valid = parse_number( value, duration_s, 0.0, SimulationConfig::MAX_DURATION_S );
+      config.duration_us = duration_s * 1e6;
+    } else if ( key == "seed" ) {
+      valid = parse_number( value, seed, 0u );
+    } else if ( key == "cc" and Controller::exists( value ) ) {
+      algorithm = value;
+    } else if ( key == "log" and not value.empty() ) {
+      /* event log on the virtual clock (see decode-log); nothing
+	 is dropped, since waiting for the disk doesn't skew the results */
+      EventLog::open( value, true );
+    } else {
+      valid = false;
+    }
+
+    if ( not valid ) {
+      cerr << "Unknown or invalid option: " << arg << endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  const unique_ptr<Controller> controller = Controller::make( algorithm, debug );
+  controller->seed( seed );
+
+  const clock_t cpu_start = clock();
+  const SimulationResult result = simulate( config, *controller );
+  const double cpu_seconds = double( clock() - cpu_start ) / CLOCKS_PER_SEC;
+  EventLog::close();
+
+  cout << fixed << setprecision( 2 );
+  cout << "Average capacity: " << result.capacity_mbps << " Mbits/s" << endl;
+  cout << "Average throughput: " << result.throughput_mbps << " Mbits/s ("
+       << 100 * result.throughput_mbps / result.capacity_mbps << "% utilization)" << endl;
+  cout << "95th percentile per-packet queueing delay: " << result.delay_p95_ms << " ms" << endl;
+  cout << "95th percentile signal delay: " << result.signal_delay_p95_ms << " ms" << endl;
+  cout << "Power score: " << result.power() << " (Mbits/s)/s" << endl;
+  cout << "Datagrams sent: " << result.datagrams_sent
+       << ", delivered: " << result.datagrams_delivered
+       << ", dropped: " << result.datagrams_dropped << endl;
+  cout << setprecision( 3 ) << "Simulated " << result.duration_s << " s in "
+       << cpu_seconds << " s of CPU" << endl;
+
+  return EXIT_SUCCESS;
+}
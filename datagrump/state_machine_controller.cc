@@ -0,0 +1,282 @@
+#include <iostream>
+#include <cmath>
+#include <cstdlib>
+#include <cstdio>
+#include <limits>
+#include <cstddef>
+#include <vector>
+
+#include "state_machine_controller.hh"
+#include "path_model.hh"
+#include "event_log.hh"
+#include "timestamp.hh"
+
+using namespace std;
+
+/* Default constructor */
+StateMachineController::StateMachineController( const bool debug, const Params & params )
+  : Controller( debug ),
+    alpha(params.alpha),
+    beta(params.beta),
+    inc(params.inc),
+    base_prob_probability(params.base_prob_probability),
+    stable_queue_us(params.stable_queue_us),
+    panic_ratio(params.panic_ratio),
+    rtt_ewma(params.rtt_ewma),
+    keep(params.keep),
+    random_(params.seed),
+    window_size_(0.f),
+    state(0),
+    update(true),
+    outstanding(0),
+    prob_probability(base_prob_probability),
+    rtt(-1),
+    queue_delay(0),
+    q_(0),
+    timeout(80000), /* 80 ms */
+    target(1),
+    left(1),
+    next_transmission(0),
+    last_ack(make_pair(0, 0)),
+    ts_rtt(),
+    bdp(0)
+{}
+
+void StateMachineController::get_stat(float &min_rtt, float &mean, float &dev)
+{
+  min_rtt = ts_rtt.min();
+  mean = ts_rtt.mean();
+  dev = ts_rtt.stddev();
+}
+
+/* Get current window size, in datagrams */
+unsigned int StateMachineController::window_size()
+{
+  /* Default: fixed window size of 100 outstanding datagrams */
+
+  int the_window_size = floor(window_size_);
+
+  if ( debug_ ) {
+    // cerr << "At time " << timestamp_ms()
+	 // << " window size is " << the_window_size << endl;
+  }
+
+  return the_window_size;
+}
+
+/* A datagram was sent */
+void StateMachineController::datagram_was_sent( const uint64_t /* sequence_number */,
+				    /* of the sent datagram */
+				    const uint64_t send_timestamp,
+                                    /* in microseconds */
+				    const bool after_timeout
+				    /* datagram was sent because of a timeout */ )
+{
+
+  /* AIMD: multiplicative decrease on timeout */
+  if(after_timeout and left == 0){
+    outstanding = target; // current outstanding
+    target *= beta; // halving the target
+    timeout *= 2; // exponential backoff
+  }
+
+  if(left > 0)
+    left--;
+  
+  if(left == 0){
+    timeout = 2*max((long)rtt, (long)40000); // at least 40 ms
+  } else {
+    timeout = rtt / target; // evenly spaced;
+  }
+
+  // next transmission time
+  next_transmission = send_timestamp + timeout;
+
+  timeout = max((long)1, timeout);
+  window_size_ = max(1.f, window_size_ + 1); 
+}
+
+/* An ack was received */
+void StateMachineController::ack_received( const uint64_t sequence_number_acked,
+			       /* what sequence number was acknowledged */
+			       const uint64_t send_timestamp_acked,
+			       /* when the acknowledged datagram was sent (sender's clock) */
+			       const uint64_t recv_timestamp_acked,
+			       /* when the acknowledged datagram was received (receiver's clock)*/
+			       const uint64_t timestamp_ack_received )
+                               /* when the ack was received (by sender) */
+{
+  window_size_ = window_size_ - 1;
+  uint64_t rtt_ = (timestamp_ack_received - send_timestamp_acked);
+  ts_rtt.push(timestamp_ack_received, rtt_);
+  
+  // update_queue_delay
+  pair<long, long> current_ack = make_pair(send_timestamp_acked, recv_timestamp_acked);
+  q_ = max((long)0, q_ + (current_ack.second - last_ack.second) - (current_ack.first - last_ack.first)); // queue delay for current packet
+  if(queue_delay > 0)
+    queue_delay = queue_delay * 0.9f + 0.1f * q_;
+  else 
+    queue_delay = q_;
+  last_ack = current_ack;
+
+  long delay = (current_ack.second - last_ack.second) - (current_ack.first - last_ack.first);
+
+  // refine the window
+  ts_rtt.expire(timestamp_ack_received, keep*(float)rtt_);
+
+  // update outstanding number of packets
+  outstanding = max(0, outstanding - 1);
+  update = (outstanding == 0);
+
+  float rtt_new;
+
+  if(rtt < 0){
+    rtt_new = rtt_;
+    rtt = rtt_;
+  }
+  else {
+    rtt_new = rtt_ewma*rtt + (1-rtt_ewma)*rtt_; // moving mean
+  }
+
+  rtt = rtt_new;
+  rtt_ = rtt; // this is to remove the effect noise 
+
+  float min_rtt, mean, dev;
+  get_stat(min_rtt, mean, dev);
+
+  // bool stable = (dev/mean < 0.1) || (min(rtt_, (timestamp_ack_received - send_timestamp_acked))/min_rtt < 1.1);
+  // bool panic = (timestamp_ack_received - send_timestamp_acked)/min_rtt > 2;
+
+  bool stable = (q_ < stable_queue_us); // under 10 ms of queueing, by default
+  bool panic = (q_/max(queue_delay, 0.000001f) > panic_ratio); // max for numeric stability
+  
+  // bool queue_cleared = ((timestamp_ack_received - send_timestamp_acked)/min_rtt) < 1.1;
+  // state transitions
+  // 0 : unstable
+  // 1 : stable
+  // 2 : prob
+  // 3 : cool off
+  bool state_change = false;
+  const int previous_state = state;
+  bool short_circuit = false;
+  if(panic && state != 0 && state != 3){ // significant increase in the rtt compared to prvious min
+    state_change = true;
+    if(state == 2){
+      target = target/(inc);
+    }
+    prob_probability = base_prob_probability;
+    state = 0;
+    outstanding = 0;
+    short_circuit = true;
+  }
+  else if(state == 0 && stable){ // queue has cleared
+    state_change = true;
+    state = 1;
+    outstanding = target;
+    prob_probability = base_prob_probability;
+
+  } else if(state == 0 && outstanding == 0){
+    state_change = true;
+    outstanding = target;
+    left = target;
+    // timeout = rtt/target + q_;
+    // next_transmission = (long)timestamp_ack_received + (int)q_ + timeout;
+  }else if(state == 1 && outstanding == 0){
+    state_change = true;
+    if(stable){
+      float seed = (random_() %100 )/ 100.0;
+      if(seed < prob_probability){
+        state = 2;
+        outstanding = target;
+        target = target * inc;
+      }else{
+        state = 1;
+        outstanding = target;
+        target = max(target + alpha, bdp); // stable increase, or straight to the measured BDP
+        left = target;
+        prob_probability = min(1.0, prob_probability*1.1); 
+      }
+    } else {
+      outstanding = target;
+      state = 0;
+    }
+  } else if(state == 2 && outstanding == 0){
+    state_change = true;
+    outstanding = target;
+    target = max((long)1, (long)(target/(inc)));
+    state = 3;
+  } else if(state == 3 && outstanding == 0){
+    state_change = true;
+    if(stable){
+      outstanding = target;
+      target = (target/(2-inc))*inc*inc; // probe successful change baseline and being next probe
+      state = 2;
+    } else {
+      outstanding = target;
+      target = target/(2-inc);
+      prob_probability = base_prob_probability;
+      state = 1; // go to stable phase
+    }
+  }
+
+  if(!stable && state == 0){ // halving only when unstable
+    if(update){
+      state_change = true;
+      outstanding = target;
+      target = max((long)1, (long)(target*beta));
+    }
+  }
+  
+  if(state_change){
+    timeout = rtt/target + delay;
+    left = target;
+    next_transmission = timestamp_ack_received + timeout;
+  } else {
+    long time_left = next_transmission - (long)timestamp_ack_received;
+    time_left += delay; // incorporate delay information
+    timeout = time_left;
+    next_transmission = timestamp_ack_received + timeout;
+  }
+
+  timeout = max(timeout, (long)1);
+
+  if(state != previous_state or short_circuit){
+    EventLog::log( EventLog::Type::StateMachineTransition, timestamp_ack_received, flow_id_,
+                   state, sequence_number_acked,
+                   previous_state, target, q_, prob_probability, short_circuit );
+  }
+
+  EventLog::log( EventLog::Type::StateMachineState, timestamp_ack_received, flow_id_,
+                 state, sequence_number_acked,
+                 q_, queue_delay, target, outstanding, timeout );
+}
+
+/* The path model took a new sample */
+void StateMachineController::path_measured( const PathModel & path )
+{
+  bdp = path.bdp_datagrams();
+}
+
+/* How long to wait (in microseconds) if there are no acks
+   before sending one more datagram */
+unsigned int StateMachineController::timeout_us()
+{
+  return timeout;
+}
+
+/* Seed the choice to probe */
+void StateMachineController::seed( const unsigned int seed )
+{
+  random_.seed( seed );
+}
+
+/* How fast to release datagrams while the window is open */
+double StateMachineController::pacing_rate()
+{
+  /* spread the target evenly over one RTT, as the timeouts do */
+  if ( rtt <= 0 ) {
+    return 0;
+  }
+
+  return target * 1e6 / rtt;
+}
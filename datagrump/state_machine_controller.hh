@@ -0,0 +1,101 @@
+#ifndef STATE_MACHINE_CONTROLLER_HH
+#define STATE_MACHINE_CONTROLLER_HH
+
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <utility>
+
+#include "controller.hh"
+#include "windowed_stats.hh"
+
+using namespace std;
+
+/* Delay-based controller that moves between unstable, stable, probe
+   and cool-off states, growing its target while the queue stays short */
+
+class StateMachineController : public Controller
+{
+public:
+  /* the hand-picked constants (see tuner.cc, which searches over them) */
+  struct Params
+  {
+    float alpha; /* additive increase per stable round, in datagrams */
+    float beta; /* multiplicative decrease when unstable */
+    float inc; /* multiplier when probing */
+    float base_prob_probability; /* chance of probing, after each reset */
+    float stable_queue_us; /* stable while the queueing delay is under this */
+    float panic_ratio; /* panic when the queueing delay jumps by this factor over its average */
+    float rtt_ewma; /* weight of the old RTT in its moving average */
+    float keep; /* how many RTTs of RTT samples to keep */
+    unsigned int seed; /* for the choice to probe */
+
+    Params()
+      : alpha( 3 ), beta( 0.7 ), inc( 1.25 ), base_prob_probability( 0.4 ),
+	stable_queue_us( 10000 ), panic_ratio( 3 ), rtt_ewma( 0.95 ), keep( 2 ),
+	seed( 1 ) {}
+  };
+
+private:
+  /* Add member variables here */
+  const float alpha;
+  const float beta;
+  const float inc; /* multiplier when probing */
+  const float base_prob_probability; /* chance of probing, after each reset */
+  const float stable_queue_us;
+  const float panic_ratio;
+  const float rtt_ewma;
+  const float keep;
+  std::minstd_rand random_; /* this instance's own, so runs in parallel are repeatable */
+  float window_size_;
+  int state;
+  bool update;
+  int outstanding;
+  float prob_probability;
+  float rtt;
+  float queue_delay;
+  long q_;
+  long timeout;
+  int target;
+  int left;
+  long next_transmission;
+  pair<long, long> last_ack; 
+  WindowedStats ts_rtt; /* RTT samples, keyed by when their ack arrived */
+  float bdp; /* measured bandwidth-delay product, in datagrams (0 until known) */
+  void update_member(bool timeout, int state);
+  void get_stat(float &min, float &mean, float &dev);
+public:
+  /* Default constructor */
+  StateMachineController( const bool debug, const Params & params = Params() );
+
+  /* Get current window size, in datagrams */
+  unsigned int window_size() override;
+
+  /* A datagram was sent */
+  void datagram_was_sent( const uint64_t sequence_number,
+        const uint64_t send_timestamp,
+        const bool after_timeout ) override;
+
+  /* An ack was received */
+  void ack_received( const uint64_t sequence_number_acked,
+         const uint64_t send_timestamp_acked,
+         const uint64_t recv_timestamp_acked,
+         const uint64_t timestamp_ack_received ) override;
+
+  /* The path model took a new sample */
+  void path_measured( const PathModel & path ) override;
+
+  /* How long to wait (in microseconds) if there are no acks
+     before sending one more datagram */
+  unsigned int timeout_us() override;
+
+  /* How fast to release datagrams while the window is open,
+     in datagrams per second (0 means send as fast as the window allows) */
+  double pacing_rate() override;
+
+  /* Seed the choice to probe */
+  void seed( const unsigned int seed ) override;
+
+};
+
+#endif
@@ -0,0 +1,297 @@
+/* search the state-machine controller's constants with trace-driven
+   simulations, run in parallel on every core, and report the Pareto
+   frontier of throughput against 95th-percentile signal delay */
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "simulation.hh"
+#include "state_machine_controller.hh"
+#include "util.hh"
+
+using namespace std;
+
+typedef StateMachineController::Params Params;
+
+namespace {
+  /* a constant to search over, and the range to search */
+  struct Dimension
+  {
+    const char * name;
+    float Params::* field;
+    float low, high;
+  };
+
+  /* the most the command-line options allow */
+  const unsigned int MAX_SAMPLES = 1 << 20, MAX_ROUNDS = 1000,
+    MAX_SEEDS = 1000, MAX_THREADS = 1024;
+
+  const vector<Dimension> dimensions = {
+    { "alpha", &Params::alpha, 0.5, 8 },
+    { "beta", &Params::beta, 0.3, 0.95 },
+    { "inc", &Params::inc, 1.05, 1.9 },
+    { "base_prob", &Params::base_prob_probability, 0.05, 1 },
+    { "stable_queue_us", &Params::stable_queue_us, 2000, 40000 },
+    { "panic_ratio", &Params::panic_ratio, 1.5, 10 },
+    { "rtt_ewma", &Params::rtt_ewma, 0.5, 0.99 },
+    { "keep", &Params::keep, 1, 8 },
+  };
+
+  struct Evaluation
+  {
+    Params params;
+    double throughput_mbps, signal_delay_p95_ms, power;
+
+    Evaluation( const Params & s_params )
+      : params( s_params ), throughput_mbps( 0 ), signal_delay_p95_ms( 0 ), power( 0 ) {}
+
+  };
+
+  /* run every candidate (averaged over several seeds) on a pool of threads */
+  void evaluate( const SimulationConfig & config, const unsigned int seeds,
+		 const unsigned int thread_count, vector<Evaluation> & candidates )
+  {
+    atomic<size_t> next( 0 );
+
+    auto worker = [&] () {
+      for ( size_t i = next++; i < candidates.size(); i = next++ ) {
+	Evaluation & candidate = candidates[ i ];
+	for ( unsigned int seed = 0; seed < seeds; seed++ ) {
+	  Params params = candidate.params;
+	  params.seed = candidate.params.seed + seed;
+	  StateMachineController controller( false, params );
+	  const SimulationResult result = simulate( config, controller );
+	  candidate.throughput_mbps += result.throughput_mbps / seeds;
+	  candidate.signal_delay_p95_ms += result.signal_delay_p95_ms / seeds;
+	}
+	candidate.power = candidate.signal_delay_p95_ms > 0
+	  ? candidate.throughput_mbps / (candidate.signal_delay_p95_ms / 1000) : 0;
+      }
+    };
+
+    vector<thread> threads;
+    for ( unsigned int i = 0; i < thread_count; i++ ) {
+      threads.emplace_back( worker );
+    }
+    for ( auto & t : threads ) {
+      t.join();
+    }
+  }
+
+  /* the evaluations no other evaluation dominates, by increasing delay */
+  vector<Evaluation> pareto_frontier( vector<Evaluation> evaluations )
+  {
+    sort( evaluations.begin(), evaluations.end(),
+	  [] ( const Evaluation & a, const Evaluation & b ) {
+	    return a.signal_delay_p95_ms < b.signal_delay_p95_ms
+	      or (a.signal_delay_p95_ms == b.signal_delay_p95_ms
+		  and a.throughput_mbps > b.throughput_mbps);
+	  } );
+
+    /* sweeping by delay, keep each point that beats every faster one's throughput */
+    vector<Evaluation> frontier;
+    for ( const auto & e : evaluations ) {
+      if ( frontier.empty() or e.throughput_mbps > frontier.back().throughput_mbps ) {
+	frontier.push_back( e );
+      }
+    }
+    return frontier;
+  }
+
+  /* how many points grid( steps ) makes, or just past MAX_SAMPLES if more */
+  uint64_t grid_size( const unsigned int steps )
+  {
+    uint64_t size = 1;
+    for ( size_t d = 0; d < dimensions.size() and size <= MAX_SAMPLES; d++ ) {
+      size *= steps;
+    }
+    return min( size, uint64_t( MAX_SAMPLES ) + 1 );
+  }
+
+  /* every combination of `steps` evenly spaced values per dimension */
+  vector<Evaluation> grid( const unsigned int steps )
+  {
+    vector<Evaluation> candidates;
+    candidates.reserve( grid_size( steps ) );
+    vector<unsigned int> index( dimensions.size(), 0 );
+
+    while ( true ) {
+      Params params;
+      for ( size_t d = 0; d < dimensions.size(); d++ ) {
+	const Dimension & dim = dimensions[ d ];
+	params.*dim.field = steps == 1 ? dim.low
+	  : dim.low + (dim.high - dim.low) * index[ d ] / (steps - 1);
+      }
+      candidates.emplace_back( params );
+
+      /* next combination, odometer-style */
+      size_t d = 0;
+      while ( d < dimensions.size() and ++index[ d ] == steps ) {
+	index[ d++ ] = 0;
+      }
+      if ( d == dimensions.size() ) {
+	return candidates;
+      }
+    }
+  }
+
+  /* uniformly random points */
+  vector<Evaluation> random_points( const unsigned int count, minstd_rand & random )
+  {
+    vector<Evaluation> candidates;
+    for ( unsigned int i = 0; i < count; i++ ) {
+      Params params;
+      for ( const auto & dim : dimensions ) {
+	params.*dim.field = uniform_real_distribution<float>( dim.low, dim.high )( random );
+      }
+      candidates.emplace_back( params );
+    }
+    return candidates;
+  }
+
+  /* points near the current frontier: each constant of a frontier point
+     moved by a random fraction of its range (shrinking each round) */
+  vector<Evaluation> around( const vector<Evaluation> & frontier, const unsigned int count,
+			     const float spread, minstd_rand & random )
+  {
+    vector<Evaluation> candidates;
+    normal_distribution<float> step( 0, spread );
+    for ( unsigned int i = 0; i < count; i++ ) {
+      Params params = frontier[ random() % frontier.size() ].params;
+      for ( const auto & dim : dimensions ) {
+	const float moved = params.*dim.field + step( random ) * (dim.high - dim.low);
+	params.*dim.field = min( dim.high, max( dim.low, moved ) );
+      }
+      candidates.emplace_back( params );
+    }
+    return candidates;
+  }
+
+  void print( const Evaluation & e )
+  {
+    cout << setw( 10 ) << e.throughput_mbps << setw( 10 ) << e.signal_delay_p95_ms
+	 << setw( 10 ) << e.power;
+    for ( const auto & dim : dimensions ) {
+      cout << " " << dim.name << "=" << e.params.*dim.field;
+    }
+    cout << endl;
+  }
+}
+
+int main( int argc, char *argv[] )
+{
+   /* check the command-line arguments */
+  if ( argc < 1 ) { /* for sticklers */
+    abort();
+  }
+
+  if ( argc < 2 ) {
+    cerr << "Usage: " << argv[ 0 ] << " UPLINK-TRACE [search=grid|random|refine] [steps=N] [samples=N]"
+	 << " [rounds=N] [seeds=N] [threads=N] [delay=MS] [queue=PACKETS] [duration=S] [seed=N]" << endl
+	 << "  grid:   steps=N evenly spaced values of each constant (N^" << dimensions.size()
+	 << " runs, at most " << MAX_SAMPLES << ")" << endl
+	 << "  random: samples=N uniformly random points" << endl
+	 << "  refine: samples=N random points, then rounds=N of samples=N points around the frontier" << endl;
+    return EXIT_FAILURE;
+  }
+
+  SimulationConfig config;
+  config.uplink = LinkTrace::load( argv[ 1 ] );
+
+  string search = "random";
+  unsigned int steps = 2, samples = 256, rounds = 4, seeds = 1, seed = 0;
+  unsigned int thread_count = max( 1u, thread::hardware_concurrency() );
+
+  for ( int i = 2; i < argc; i++ ) {
+    const string arg = argv[ i ];
+    const string::size_type equals = arg.find( '=' );
+    const string key = arg.substr( 0, equals );
+    const string value = equals == string::npos ? "" : arg.substr( equals + 1 );
+    bool valid = true;
+    uint64_t delay_ms = 0;
+    double duration_s = 0;
+
+    if ( key == "search" and (value == "grid" or value == "random" or value == "refine") ) {
+      search = value;
+    } else if ( key == "steps" ) {
+      valid = parse_number( value, steps, 1u, MAX_SAMPLES ) and grid_size( steps ) <= MAX_SAMPLES;
+    } else if ( key == "samples" ) {
+      valid = parse_number( value, samples, 1u, MAX_SAMPLES );
+    } else if ( key == "rounds" ) {
+      valid = parse_number( value, rounds, 0u, MAX_ROUNDS );
+    } else if ( key == "seeds" ) {
+      valid = parse_number( value, seeds, 1u, MAX_SEEDS );
+    } else if ( key == "threads" ) {
+      valid = parse_number( value, thread_count, 1u, MAX_THREADS );
+    } else if ( key == "delay" ) {
+      valid = parse_number( value, delay_ms, uint64_t( 0 ), SimulationConfig::MAX_DELAY_MS );
+      config.one_way_delay_us = delay_ms * 1000;
+    } else if ( key == "queue" ) {
+      valid = parse_number( value, config.queue_limit_packets, 0u );
+    } else if ( key == "duration" ) {
+      valid = parse_number( value, duration_s, 0.0, SimulationConfig::MAX_DURATION_S );
+      config.duration_us = duration_s * 1e6;
+    } else if ( key == "seed" ) {
+      valid = parse_number( value, seed, 0u );
+    } else {
+      valid = false;
+    }
+
+    if ( not valid ) {
+      cerr << "Unknown or invalid option: " << arg << endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  minstd_rand random( seed );
+
+  /* the hand-picked constants, for comparison */
+  vector<Evaluation> evaluations = { Evaluation( Params() ) };
+
+  if ( search == "grid" ) {
+    const vector<Evaluation> points = grid( steps );
+    evaluations.insert( evaluations.end(), points.begin(), points.end() );
+  } else {
+    const vector<Evaluation> points = random_points( samples, random );
+    evaluations.insert( evaluations.end(), points.begin(), points.end() );
+  }
+
+  cerr << "Evaluating " << evaluations.size() << " points on " << thread_count << " threads..." << endl;
+  evaluate( config, seeds, thread_count, evaluations );
+
+  if ( search == "refine" ) {
+    float spread = 0.1;
+    for ( unsigned int round = 0; round < rounds; round++, spread /= 2 ) {
+      vector<Evaluation> points = around( pareto_frontier( evaluations ), samples, spread, random );
+      cerr << "Refining around the frontier: " << points.size() << " more points..." << endl;
+      evaluate( config, seeds, thread_count, points );
+      evaluations.insert( evaluations.end(), points.begin(), points.end() );
+    }
+  }
+
+  cout << fixed << setprecision( 2 );
+  cout << "Hand-picked constants:" << endl;
+  cout << setw( 10 ) << "Mbits/s" << setw( 10 ) << "delay ms" << setw( 10 ) << "power" << endl;
+  print( evaluations.front() );
+
+  cout << endl << "Pareto frontier (throughput against 95th percentile signal delay):" << endl;
+  cout << setw( 10 ) << "Mbits/s" << setw( 10 ) << "delay ms" << setw( 10 ) << "power" << endl;
+  for ( const auto & e : pareto_frontier( evaluations ) ) {
+    print( e );
+  }
+
+  const Evaluation & best = *max_element( evaluations.begin(), evaluations.end(),
+					  [] ( const Evaluation & a, const Evaluation & b ) {
+					    return a.power < b.power;
+					  } );
+  cout << endl << "Best power score:" << endl;
+  print( best );
+
+  return EXIT_SUCCESS;
+}
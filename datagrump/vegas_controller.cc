@@ -0,0 +1,103 @@
+#include <algorithm>
+
+#include "vegas_controller.hh"
+#include "event_log.hh"
+
+using namespace std;
+
+VegasController::VegasController( const bool debug )
+  : Controller( debug ),
+    window_( INITIAL_WINDOW ),
+    slow_start_( true ),
+    base_rtt_us_( 0 ),
+    round_min_rtt_us_( 0 ),
+    srtt_us_( 0 ),
+    round_end_( 0 ),
+    next_sequence_number_( 0 ),
+    recovery_end_( 0 )
+{}
+
+unsigned int VegasController::window_size()
+{
+  return window_;
+}
+
+void VegasController::datagram_was_sent( const uint64_t sequence_number,
+					 const uint64_t send_timestamp,
+					 const bool after_timeout )
+{
+  next_sequence_number_ = max( next_sequence_number_, sequence_number + 1 );
+
+  if ( after_timeout ) {
+    window_ = max( 2.0, window_ / 2 );
+    slow_start_ = false;
+
+    EventLog::log( EventLog::Type::WindowCut, send_timestamp, flow_id_, true, sequence_number,
+		   window_ );
+  }
+}
+
+/* like Reno, halve the window for a loss (once per window) */
+void VegasController::packet_lost( const uint64_t sequence_number,
+				   const uint64_t send_timestamp )
+{
+  if ( sequence_number < recovery_end_ ) {
+    return;
+  }
+
+  window_ = max( 2.0, window_ / 2 );
+  slow_start_ = false;
+  recovery_end_ = next_sequence_number_;
+
+  EventLog::log( EventLog::Type::WindowCut, send_timestamp, flow_id_, false, sequence_number,
+		 window_ );
+}
+
+/* compare the round's RTT with the base RTT and adjust the window */
+void VegasController::end_round( const uint64_t sequence_number, const uint64_t timestamp )
+{
+  const double queued = window_ * (1 - base_rtt_us_ / round_min_rtt_us_);
+
+  if ( slow_start_ ) {
+    if ( queued > GAMMA ) {
+      slow_start_ = false;
+      window_ = max( 2.0, window_ - queued );
+    } else {
+      window_ *= 2;
+    }
+  } else if ( queued < ALPHA ) {
+    window_ += 1;
+  } else if ( queued > BETA ) {
+    window_ = max( 2.0, window_ - 1 );
+  }
+
+  EventLog::log( EventLog::Type::ControllerState, timestamp, flow_id_, slow_start_, sequence_number,
+		 window_, queued );
+
+  round_end_ = next_sequence_number_;
+  round_min_rtt_us_ = 0;
+}
+
+void VegasController::ack_received( const uint64_t sequence_number_acked,
+				    const uint64_t send_timestamp_acked,
+				    const uint64_t,
+				    const uint64_t timestamp_ack_received )
+{
+  const double rtt = max( 1.0, double( timestamp_ack_received - send_timestamp_acked ) );
+  srtt_us_ = srtt_us_ > 0 ? 0.875 * srtt_us_ + 0.125 * rtt : rtt;
+  base_rtt_us_ = base_rtt_us_ > 0 ? min( base_rtt_us_, rtt ) : rtt;
+  round_min_rtt_us_ = round_min_rtt_us_ > 0 ? min( round_min_rtt_us_, rtt ) : rtt;
+
+  EventLog::log( EventLog::Type::RttSample, timestamp_ack_received, flow_id_, 0, sequence_number_acked,
+		 rtt, srtt_us_, base_rtt_us_, rtt - base_rtt_us_, window_ );
+
+  if ( sequence_number_acked >= round_end_ ) {
+    end_round( sequence_number_acked, timestamp_ack_received );
+  }
+}
+
+unsigned int VegasController::timeout_us()
+{
+  /* wait a second for the first RTT sample, then twice the smoothed RTT */
+  return srtt_us_ > 0 ? max( 2 * srtt_us_, 20000.0 ) : 1000000;
+}
@@ -0,0 +1,52 @@
+#ifndef VEGAS_CONTROLLER_HH
+#define VEGAS_CONTROLLER_HH
+
+#include <cstdint>
+
+#include "controller.hh"
+
+/* TCP Vegas: once per round trip, estimate how many of our datagrams
+   are sitting in the bottleneck queue, window * (1 - base RTT / RTT),
+   and nudge the window to keep that between ALPHA and BETA */
+
+class VegasController : public Controller
+{
+private:
+  double window_; /* in datagrams */
+  bool slow_start_;
+
+  double base_rtt_us_; /* smallest RTT seen (0 until the first sample) */
+  double round_min_rtt_us_; /* smallest RTT in the current round (0 if none) */
+  double srtt_us_;
+
+  /* the round ends once this datagram is acknowledged */
+  uint64_t round_end_;
+  uint64_t next_sequence_number_;
+
+  /* no further decrease for losses until this datagram is sent */
+  uint64_t recovery_end_;
+
+  void end_round( const uint64_t sequence_number, const uint64_t timestamp );
+
+public:
+  static constexpr double ALPHA = 2; /* fewer datagrams queued than this: grow */
+  static constexpr double BETA = 4; /* more than this: shrink */
+  static constexpr double GAMMA = 1; /* more than this: leave slow start */
+  static constexpr double INITIAL_WINDOW = 4;
+
+  VegasController( const bool debug );
+
+  unsigned int window_size() override;
+  void datagram_was_sent( const uint64_t sequence_number,
+			  const uint64_t send_timestamp,
+			  const bool after_timeout ) override;
+  void ack_received( const uint64_t sequence_number_acked,
+		     const uint64_t send_timestamp_acked,
+		     const uint64_t recv_timestamp_acked,
+		     const uint64_t timestamp_ack_received ) override;
+  void packet_lost( const uint64_t sequence_number,
+		    const uint64_t send_timestamp ) override;
+  unsigned int timeout_us() override;
+};
+
+#endif /* VEGAS_CONTROLLER_HH */
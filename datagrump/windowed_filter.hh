@@ -0,0 +1,82 @@
+#ifndef WINDOWED_FILTER_HH
+#define WINDOWED_FILTER_HH
+
+#include <cstdint>
+#include <functional>
+
+/* Best (e.g. maximum or minimum) of the samples seen over a sliding
+   window, tracked with Kathleen Nichols' algorithm (as in Linux's
+   lib/minmax.c): keep the best, second-best and third-best samples from
+   successive sub-windows, so each update is O(1) with no storage beyond
+   three samples. Time can be any nondecreasing count (microseconds,
+   round trips, ...). Better(a, b) says whether a is better than b. */
+
+template <typename T, typename Better>
+class WindowedFilter
+{
+private:
+  struct Estimate
+  {
+    uint64_t time;
+    T value;
+  };
+
+  uint64_t window_;
+  Better better_;
+  bool empty_;
+  Estimate estimates_[ 3 ]; /* best, second best, third best */
+
+  bool at_least_as_good( const T & a, const T & b ) const { return not better_( b, a ); }
+
+  void reset( const Estimate & sample )
+  {
+    estimates_[ 0 ] = estimates_[ 1 ] = estimates_[ 2 ] = sample;
+    empty_ = false;
+  }
+
+public:
+  WindowedFilter( const uint64_t window )
+    : window_( window ), better_(), empty_( true ), estimates_()
+  {}
+
+  /* take a sample */
+  void update( const uint64_t time, const T & value )
+  {
+    const Estimate sample = { time, value };
+
+    if ( empty_ or at_least_as_good( value, estimates_[ 0 ].value )
+	 or time - estimates_[ 2 ].time > window_ ) {
+      reset( sample ); /* a new best, or nothing left in the window */
+      return;
+    }
+
+    if ( at_least_as_good( value, estimates_[ 1 ].value ) ) {
+      estimates_[ 1 ] = estimates_[ 2 ] = sample;
+    } else if ( at_least_as_good( value, estimates_[ 2 ].value ) ) {
+      estimates_[ 2 ] = sample;
+    }
+
+    /* age the estimates as their sub-windows pass */
+    const uint64_t age = time - estimates_[ 0 ].time;
+    if ( age > window_ ) {
+      estimates_[ 0 ] = estimates_[ 1 ];
+      estimates_[ 1 ] = estimates_[ 2 ];
+      estimates_[ 2 ] = sample;
+      if ( time - estimates_[ 0 ].time > window_ ) {
+	estimates_[ 0 ] = estimates_[ 1 ];
+	estimates_[ 1 ] = estimates_[ 2 ];
+      }
+    } else if ( estimates_[ 1 ].time == estimates_[ 0 ].time and age > window_ / 4 ) {
+      estimates_[ 1 ] = estimates_[ 2 ] = sample;
+    } else if ( estimates_[ 2 ].time == estimates_[ 1 ].time and age > window_ / 2 ) {
+      estimates_[ 2 ] = sample;
+    }
+  }
+
+  bool empty() const { return empty_; }
+
+  /* best sample in the window (which must not be empty) */
+  const T & best() const { return estimates_[ 0 ].value; }
+};
+
+#endif /* WINDOWED_FILTER_HH */
@@ -0,0 +1,70 @@
+#include <algorithm>
+#include <cmath>
+
+#include "windowed_stats.hh"
+
+using namespace std;
+
+/* double the ring, unwrapping the contents to the front */
+void WindowedStats::SampleRing::grow()
+{
+  vector<Sample> bigger( storage_.size() * 2 );
+  for ( size_t i = 0; i < count_; i++ ) {
+    bigger[ i ] = storage_[ (head_ + i) & mask() ];
+  }
+  storage_.swap( bigger );
+  head_ = 0;
+}
+
+void WindowedStats::SampleRing::push_back( const Sample & sample )
+{
+  if ( count_ == storage_.size() ) {
+    grow();
+  }
+  storage_[ (head_ + count_) & mask() ] = sample;
+  count_++;
+}
+
+/* add a sample */
+void WindowedStats::push( const uint64_t timestamp, const uint64_t value )
+{
+  const Sample sample = { next_index_++, timestamp, value };
+  samples_.push_back( sample );
+  sum_ += value;
+  sum_of_squares_ += value * value;
+
+  /* a new sample outlives every older sample, so older ones
+     that are no smaller can never be the minimum again */
+  while ( not minima_.empty() and minima_.back().value >= value ) {
+    minima_.pop_back();
+  }
+  minima_.push_back( sample );
+}
+
+/* drop samples more than max_age older than now */
+void WindowedStats::expire( const uint64_t now, const double max_age )
+{
+  while ( not samples_.empty() and (now - samples_.front().timestamp) > max_age ) {
+    const Sample & oldest = samples_.front();
+    sum_ -= oldest.value;
+    sum_of_squares_ -= oldest.value * oldest.value;
+
+    if ( minima_.front().index == oldest.index ) {
+      minima_.pop_front();
+    }
+
+    samples_.pop_front();
+  }
+}
+
+double WindowedStats::mean() const
+{
+  return double( sum_ ) / samples_.size();
+}
+
+double WindowedStats::stddev() const
+{
+  const double the_mean = mean();
+  const double variance = double( sum_of_squares_ ) / samples_.size() - the_mean * the_mean;
+  return sqrt( max( 0.0, variance ) );
+}
@@ -0,0 +1,77 @@
+#ifndef WINDOWED_STATS_HH
+#define WINDOWED_STATS_HH
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+/* Min, mean and standard deviation of timestamped samples over a
+   sliding time window, in amortized O(1) per sample. Samples live in
+   contiguous ring buffers that only grow when the window does, so a
+   steady-state window never allocates. */
+
+class WindowedStats
+{
+private:
+  struct Sample
+  {
+    uint64_t index; /* position in the stream of all samples */
+    uint64_t timestamp;
+    uint64_t value;
+  };
+
+  /* double-ended queue of samples in a power-of-two ring buffer */
+  class SampleRing
+  {
+  private:
+    std::vector<Sample> storage_;
+    size_t head_, count_;
+
+    size_t mask() const { return storage_.size() - 1; }
+    void grow();
+
+  public:
+    SampleRing() : storage_( 16 ), head_( 0 ), count_( 0 ) {}
+
+    bool empty() const { return count_ == 0; }
+    size_t size() const { return count_; }
+    const Sample & front() const { return storage_[ head_ ]; }
+    const Sample & back() const { return storage_[ (head_ + count_ - 1) & mask() ]; }
+
+    void push_back( const Sample & sample );
+    void pop_front() { head_ = (head_ + 1) & mask(); count_--; }
+    void pop_back() { count_--; }
+  };
+
+  /* every sample in the window, oldest first */
+  SampleRing samples_;
+
+  /* samples that could still become the window minimum:
+     values strictly increase from front to back */
+  SampleRing minima_;
+
+  /* index of the next sample to be pushed */
+  uint64_t next_index_;
+
+  /* running totals over the window */
+  uint64_t sum_;
+  uint64_t sum_of_squares_;
+
+public:
+  WindowedStats()
+    : samples_(), minima_(), next_index_( 0 ), sum_( 0 ), sum_of_squares_( 0 ) {}
+
+  /* add a sample (timestamps must not decrease) */
+  void push( const uint64_t timestamp, const uint64_t value );
+
+  /* drop samples more than max_age older than now */
+  void expire( const uint64_t now, const double max_age );
+
+  /* statistics over the current window (which must not be empty) */
+  size_t size() const { return samples_.size(); }
+  uint64_t min() const { return minima_.front().value; }
+  double mean() const;
+  double stddev() const;
+};
+
+#endif /* WINDOWED_STATS_HH */
@@ -1,10 +1,12 @@
 /* simple TCP listener/server to demonstrate sourdough starter classes */
 /* Keith Winstein <keithw@cs.stanford.edu>, January 2015 */
 
-#include <thread>
 #include <iostream>
+#include <mutex>
 
-#include "socket.hh"
+#include <sys/resource.h>
+
+#include "tcp_server.hh"
 #include "util.hh"
 
 using namespace std;
@@ -16,54 +18,64 @@ int main( int argc, char *argv[] )
     abort();
   }
 
-  if ( argc != 2 ) {
-    cerr << "Usage: " << argv[ 0 ] << " PORT" << endl;
+  if ( argc < 2 or argc > 3 ) {
+    cerr << "Usage: " << argv[ 0 ] << " PORT [threads=N]" << endl;
     return EXIT_FAILURE;
   }
 
-  /* create a TCP socket */
-  TCPSocket listening_socket;
-
-  /* it's ok to reuse the server's address as soon as the program quits
-     (this helps debugging, at the slight cost to robustness) */
-  listening_socket.set_reuseaddr();
-
-  /* "bind" the socket to the user-specified local port number */
-  listening_socket.bind( Address( "::0", argv[ 1 ] ) );
-
-  /* mark the socket as listening for incoming connections */
-  listening_socket.listen();
-  cerr << "Listening on local address: " << listening_socket.local_address().to_string() << endl;
+  /* threads=N runs N event loops (by default, one per core) */
+  unsigned int loop_count = 0;
+  if ( argc == 3 ) {
+    const string arg = argv[ 2 ];
+    if ( arg.substr( 0, 8 ) != "threads="
+	 or not parse_number( arg.substr( 8 ), loop_count, 0u, 1024u ) ) {
+      cerr << "Usage: " << argv[ 0 ] << " PORT [threads=N]" << endl;
+      return EXIT_FAILURE;
+    }
+  }
 
-  /* Wait for clients to connect */
-  while ( true ) {
-
-    /* This line does a lot. It waits for a client to connect
-       ("listening_socket.accept()"). When that returns a new socket,
-       it starts a thread to handle that client and passes in the
-       result of accept() as the "client" parameter to the handler. */
-
-    thread client_handler( [] ( TCPSocket client ) {
-	cerr << "New connection from " << client.peer_address().to_string() << endl;
-
-	/* Print every line that the client sends */
-	while ( true ) {
-	  const string chunk = client.read();
-	  if ( client.eof() ) { break; }
-	  cerr << "Got " << chunk.size() << " bytes from "
-	       << client.peer_address().to_string() << ": " << chunk;
-	  client.write( "Received " + to_string( chunk.size() ) + " bytes from you.\n" );
+  /* every connection is a file descriptor: allow as many as we may */
+  rlimit files;
+  SystemCall( "getrlimit", getrlimit( RLIMIT_NOFILE, &files ) );
+  files.rlim_cur = files.rlim_max;
+  SystemCall( "setrlimit", setrlimit( RLIMIT_NOFILE, &files ) );
+
+  /* the event loops share the terminal */
+  mutex output;
+
+  /* This does a lot. The server listens on the user-specified port;
+     connections are accepted on this thread and handed round-robin to
+     event-loop threads, each of which runs the handler below whenever one
+     of its connections has something new (or has been closed by the
+     client), so a handful of threads can serve many thousands of clients. */
+  TCPServer server( Address( "::0", argv[ 1 ] ), [&output] ( TCPServer::Connection & client ) {
+      ByteStream & stream = client.stream();
+      const string peer = client.socket().peer_address().to_string();
+
+      /* Print everything that the client sends, and acknowledge it */
+      if ( stream.buffered() ) {
+	string chunk( stream.buffered(), 0 );
+	stream.read_into( &chunk[ 0 ], chunk.size() );
+
+	{
+	  lock_guard<mutex> lock( output );
+	  cerr << "Got " << chunk.size() << " bytes from " << peer << ": " << chunk;
 	}
 
-	cerr << client.peer_address().to_string() << " closed the connection." << endl; 
-      }, listening_socket.accept() );
+	/* (if the client isn't reading, its replies are dropped once the queue is full) */
+	stream.write( "Received " + to_string( chunk.size() ) + " bytes from you.\n" );
+      }
 
-    /* Let the client handler continue to run without having
-       to keep track of it. The main thread can go back to accepting
-       new incoming connections. */
+      if ( client.finished() ) {
+	lock_guard<mutex> lock( output );
+	cerr << peer << " closed the connection." << endl;
+      }
+    }, loop_count );
 
-    client_handler.detach();
-  }
+  cerr << "Listening on local address: " << server.local_address().to_string() << endl;
+
+  /* Wait for clients to connect */
+  server.run();
 
   return EXIT_SUCCESS;
 }
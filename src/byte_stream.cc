@@ -0,0 +1,152 @@
+#include <algorithm>
+#include <cstring>
+
+#include "byte_stream.hh"
+#include "util.hh"
+
+using namespace std;
+using namespace PollerShortNames;
+
+static size_t round_up_to_power_of_two( const size_t n )
+{
+  size_t ret = 1;
+  while ( ret < n ) {
+    ret <<= 1;
+  }
+  return ret;
+}
+
+RingBuffer::RingBuffer( const size_t capacity )
+  : capacity_( round_up_to_power_of_two( capacity ) ),
+    storage_( new char[ capacity_ ] ),
+    read_position_( 0 ),
+    write_position_( 0 )
+{}
+
+size_t RingBuffer::readable( iovec ( & regions )[ 2 ] ) const
+{
+  const size_t start = offset( read_position_ );
+  const size_t first = min( size(), capacity() - start );
+
+  regions[ 0 ].iov_base = &storage_[ start ];
+  regions[ 0 ].iov_len = first;
+  regions[ 1 ].iov_base = &storage_[ 0 ];
+  regions[ 1 ].iov_len = size() - first;
+
+  return regions[ 1 ].iov_len ? 2 : first ? 1 : 0;
+}
+
+size_t RingBuffer::writable( iovec ( & regions )[ 2 ] )
+{
+  const size_t start = offset( write_position_ );
+  const size_t first = min( space(), capacity() - start );
+
+  regions[ 0 ].iov_base = &storage_[ start ];
+  regions[ 0 ].iov_len = first;
+  regions[ 1 ].iov_base = &storage_[ 0 ];
+  regions[ 1 ].iov_len = space() - first;
+
+  return regions[ 1 ].iov_len ? 2 : first ? 1 : 0;
+}
+
+size_t RingBuffer::push( const char * const data, const size_t length )
+{
+  iovec regions[ 2 ];
+  const size_t count = writable( regions );
+
+  size_t copied = 0;
+  for ( size_t i = 0; i < count and copied < length; i++ ) {
+    const size_t chunk = min( regions[ i ].iov_len, length - copied );
+    memcpy( regions[ i ].iov_base, data + copied, chunk );
+    copied += chunk;
+  }
+
+  produce( copied );
+  return copied;
+}
+
+size_t RingBuffer::pop( char * const buffer, const size_t length )
+{
+  iovec regions[ 2 ];
+  const size_t count = readable( regions );
+
+  size_t copied = 0;
+  for ( size_t i = 0; i < count and copied < length; i++ ) {
+    const size_t chunk = min( regions[ i ].iov_len, length - copied );
+    memcpy( buffer + copied, regions[ i ].iov_base, chunk );
+    copied += chunk;
+  }
+
+  consume( copied );
+  return copied;
+}
+
+ByteStream::ByteStream( FileDescriptor & fd,
+			const size_t input_capacity, const size_t output_capacity )
+  : fd_( fd ),
+    input_( input_capacity ),
+    output_( output_capacity )
+{}
+
+size_t ByteStream::fill()
+{
+  iovec regions[ 2 ];
+  const size_t count = input_.writable( regions );
+
+  /* readv() the free space, wrapped or not (one region is just a read) */
+  size_t bytes_read;
+  if ( count == 2 ) {
+    bytes_read = fd_.readv( regions, count );
+  } else {
+    bytes_read = fd_.read_into( static_cast<char *>( regions[ 0 ].iov_base ), regions[ 0 ].iov_len );
+  }
+
+  input_.produce( bytes_read );
+  return bytes_read;
+}
+
+size_t ByteStream::flush()
+{
+  iovec regions[ 2 ];
+  const size_t count = output_.readable( regions );
+
+  const size_t bytes_written = fd_.writev( regions, count );
+  output_.consume( bytes_written );
+  return bytes_written;
+}
+
+void ByteStream::add_actions( Poller & poller, const function<void( ByteStream & )> & serviced,
+			      const function<void()> & failed )
+{
+  /* run a step, handing a failure to failed if there is one (after
+     serviced returns, the stream may be gone, so nothing else touches it) */
+  const auto service = [this, serviced, failed] ( const function<void()> & step ) {
+    try {
+      step();
+    } catch ( const unix_error & ) {
+      if ( not failed ) {
+	throw;
+      }
+      failed();
+      return;
+    }
+    serviced( *this );
+  };
+
+  if ( failed ) {
+    poller.add_action( Action( fd_, Direction::Err, [failed] () {
+	  failed();
+	  return ResultType::Continue;
+	} ) );
+  }
+
+  poller.add_action( Action( fd_, Direction::In, [this, service] () {
+	service( [this] () { fill(); } );
+	return ResultType::Continue;
+      }, [this] () { return not input_.full(); }, false ) );
+
+  poller.add_action( Action( fd_, Direction::Out, [this, service] () {
+	service( [this] () { flush(); } );
+	return ResultType::Continue;
+      }, [this] () { return not output_.empty(); }, false ) );
+}
@@ -0,0 +1,116 @@
+#ifndef BYTE_STREAM_HH
+#define BYTE_STREAM_HH
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include <sys/uio.h>
+
+#include "file_descriptor.hh"
+#include "poller.hh"
+
+/* a fixed-capacity ring of bytes (left uninitialized, so memory the
+   ring never uses is never touched) */
+class RingBuffer
+{
+private:
+  size_t capacity_;
+  std::unique_ptr<char[]> storage_;
+  uint64_t read_position_, write_position_; /* bytes consumed and produced, ever */
+
+  size_t offset( const uint64_t position ) const { return position & (capacity_ - 1); }
+
+public:
+  /* capacity is rounded up to a power of two */
+  RingBuffer( const size_t capacity );
+
+  size_t capacity() const { return capacity_; }
+  size_t size() const { return write_position_ - read_position_; }
+  size_t space() const { return capacity() - size(); }
+  bool empty() const { return size() == 0; }
+  bool full() const { return space() == 0; }
+
+  /* the queued bytes, or the free space, as up to two regions
+     (the ring may wrap); returns how many regions */
+  size_t readable( iovec ( & regions )[ 2 ] ) const;
+  size_t writable( iovec ( & regions )[ 2 ] );
+
+  /* account for bytes placed in the writable regions, or taken from the readable ones */
+  void produce( const size_t length ) { write_position_ += length; }
+  void consume( const size_t length ) { read_position_ += length; }
+
+  /* copy in as much of data as fits, or out as much as is queued;
+     return how many bytes were copied */
+  size_t push( const char * const data, const size_t length );
+  size_t pop( char * const buffer, const size_t length );
+};
+
+/* Buffered byte-stream I/O on a file descriptor (a TCPSocket, say).
+   Reads fill an input ring with readv(), as much as the fd has, and are
+   handed out with read_into(); writes are queued in an output ring and
+   flushed with writev(), so a stream of small writes costs few syscalls
+   and partial writes simply leave the rest queued.
+
+   The rings are bounded, which gives backpressure both ways: write()
+   accepts only what fits, and with add_actions() the fd is read only
+   while the input ring has room, so a consumer that stops draining it
+   (because its own output is full, perhaps) stops the peer too. */
+class ByteStream
+{
+private:
+  FileDescriptor & fd_;
+  RingBuffer input_, output_;
+
+public:
+  ByteStream( FileDescriptor & fd,
+	      const size_t input_capacity = 65536, const size_t output_capacity = 262144 );
+
+  FileDescriptor & fd() { return fd_; }
+
+  /* read side */
+
+  /* read what the fd has into the input ring, up to its free space, with
+     one readv(); returns how many bytes arrived (0 at EOF or if nothing was ready) */
+  size_t fill();
+
+  /* take up to length buffered bytes, without touching the fd */
+  size_t read_into( char * const buffer, const size_t length ) { return input_.pop( buffer, length ); }
+
+  /* buffered input, to parse in place, then discard */
+  size_t readable( iovec ( & regions )[ 2 ] ) const { return input_.readable( regions ); }
+  void discard( const size_t length ) { input_.consume( length ); }
+
+  size_t buffered() const { return input_.size(); }
+  size_t read_space() const { return input_.space(); }
+
+  /* has the peer finished sending (and has everything buffered been read)? */
+  bool eof() const { return fd_.eof() and input_.empty(); }
+
+  /* write side */
+
+  /* queue as much of data as fits and return how much that was (see write_space()) */
+  size_t write( const char * const data, const size_t length ) { return output_.push( data, length ); }
+  size_t write( const std::string & data ) { return write( data.data(), data.size() ); }
+
+  /* write as much of what is queued as the fd takes, with one writev();
+     returns how many bytes went out */
+  size_t flush();
+
+  size_t queued() const { return output_.size(); }
+  size_t write_space() const { return output_.space(); }
+
+  /* Keep the stream moving under poller: whenever the fd is readable
+     and the input ring has room, fill() it; whenever the fd is writable
+     and anything is queued, flush() it. Either way, then call serviced,
+     which can consume input, queue output or check eof(). If failed is
+     given, it is called instead when the fd reports an error or hangup,
+     or a read or write fails (which otherwise throws from the poller).
+     Interest is rechecked only after these actions run: refresh() the fd
+     with the poller after using the stream from anywhere else. */
+  void add_actions( Poller & poller, const std::function<void( ByteStream & )> & serviced,
+		    const std::function<void()> & failed = std::function<void()>() );
+};
+
+#endif /* BYTE_STREAM_HH */
@@ -1,6 +1,10 @@
 #include "file_descriptor.hh"
 #include "util.hh"
 
+#include <climits>
+#include <vector>
+
+#include <fcntl.h>
 #include <unistd.h>
 
 using namespace std;
@@ -38,6 +42,19 @@ FileDescriptor::~FileDescriptor()
   }
 }
 
+/* turn O_NONBLOCK off or on */
+void FileDescriptor::set_blocking( const bool blocking )
+{
+  int flags = SystemCall( "fcntl", fcntl( fd_, F_GETFL ) );
+  if ( blocking ) {
+    flags &= ~O_NONBLOCK;
+  } else {
+    flags |= O_NONBLOCK;
+  }
+
+  SystemCall( "fcntl", fcntl( fd_, F_SETFL, flags ) );
+}
+
 /* attempt to write a portion of a string */
 string::const_iterator FileDescriptor::write( const string::const_iterator & begin,
 					      const string::const_iterator & end )
@@ -59,16 +76,87 @@ string::const_iterator FileDescriptor::write( const string::const_iterator & beg
 /* read method */
 string FileDescriptor::read( const size_t limit )
 {
-  char buffer[ BUFFER_SIZE ];
+  /* (one buffer per thread: BUFFER_SIZE is too big for the stack) */
+  static thread_local vector<char> buffer( BUFFER_SIZE );
+
+  const size_t bytes_read = read_into( buffer.data(), min( BUFFER_SIZE, limit ) );
+
+  return string( buffer.data(), bytes_read );
+}
+
+/* account for a read() or readv() of length bytes that returned bytes_read */
+size_t FileDescriptor::finish_read( const string & name, const ssize_t bytes_read, const size_t length )
+{
+  register_read();
 
-  ssize_t bytes_read = SystemCall( "read", ::read( fd_, buffer, min( BUFFER_SIZE, limit ) ) );
-  if ( bytes_read == 0 ) {
+  if ( bytes_read < 0 ) {
+    if ( errno == EAGAIN or errno == EWOULDBLOCK ) {
+      return 0;
+    }
+    throw unix_error( name );
+  }
+
+  if ( bytes_read == 0 and length > 0 ) {
     set_eof();
   }
 
+  return bytes_read;
+}
+
+/* read into a caller's buffer */
+size_t FileDescriptor::read_into( char * const buffer, const size_t length )
+{
+  return finish_read( "read", ::read( fd_, buffer, length ), length );
+}
+
+/* scatter one read across several buffers */
+size_t FileDescriptor::readv( const iovec * const buffers, const size_t count )
+{
+  const size_t iovec_count = min( count, size_t( IOV_MAX ) );
+
+  size_t length = 0;
+  for ( size_t i = 0; i < iovec_count; i++ ) {
+    length += buffers[ i ].iov_len;
+  }
+
+  return finish_read( "readv", ::readv( fd_, buffers, iovec_count ), length );
+}
+
+/* read without throwing */
+Expected<size_t> FileDescriptor::try_read( char * const buffer, const size_t length )
+{
+  Expected<size_t> result = TrySystemCall( "read", ::read( fd_, buffer, length ) );
   register_read();
 
-  return string( buffer, bytes_read );
+  if ( result.ok() and result.value() == 0 and length > 0 ) {
+    set_eof();
+  }
+
+  return result;
+}
+
+/* write without throwing */
+Expected<size_t> FileDescriptor::try_write( const char * const data, const size_t length )
+{
+  Expected<size_t> result = TrySystemCall( "write", ::write( fd_, data, length ) );
+  register_write();
+  return result;
+}
+
+/* gather from several buffers into one write */
+size_t FileDescriptor::writev( const iovec * const buffers, const size_t count )
+{
+  const ssize_t bytes_written = ::writev( fd_, buffers, min( count, size_t( IOV_MAX ) ) );
+  register_write();
+
+  if ( bytes_written < 0 ) {
+    if ( errno == EAGAIN or errno == EWOULDBLOCK ) {
+      return 0;
+    }
+    throw unix_error( "writev" );
+  }
+
+  return bytes_written;
 }
 
 /* write method */
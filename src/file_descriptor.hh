@@ -3,6 +3,10 @@
 
 #include <string>
 
+#include <sys/uio.h>
+
+#include "util.hh"
+
 /* Unix file descriptors (sockets, files, etc.) */
 class FileDescriptor
 {
@@ -16,6 +20,9 @@ private:
   std::string::const_iterator write( const std::string::const_iterator & begin,
 				     const std::string::const_iterator & end );
 
+  /* account for a read; 0 bytes is EOF, unless nothing was asked for */
+  size_t finish_read( const std::string & name, const ssize_t bytes_read, const size_t length );
+
   /* maximum size of a read */
   const static size_t BUFFER_SIZE = 1024 * 1024;
 
@@ -40,10 +47,31 @@ public:
   unsigned int read_count() const { return read_count_; }
   unsigned int write_count() const { return write_count_; }
 
+  /* with blocking off, reads and writes that can't make progress return
+     at once (read_into(), readv() and writev() then return 0) */
+  void set_blocking( const bool blocking );
+
   /* read and write methods */
   std::string read( const size_t limit = BUFFER_SIZE );
   std::string::const_iterator write( const std::string & buffer, const bool write_all = true );
 
+  /* read up to length bytes into buffer with one read() and return how many
+     arrived: 0 at EOF (see eof()), or if the fd is nonblocking and has nothing */
+  size_t read_into( char * const buffer, const size_t length );
+
+  /* the same, scattering into count buffers in order with one readv() */
+  size_t readv( const iovec * const buffers, const size_t count );
+
+  /* write from count buffers, in order, with one writev() and return how
+     many bytes went out: maybe fewer than asked, or 0 if the fd is
+     nonblocking and full */
+  size_t writev( const iovec * const buffers, const size_t count );
+
+  /* one read() or write(), with any failure (EAGAIN on a nonblocking fd,
+     say) returned in the result rather than thrown; reading 0 bytes is EOF */
+  Expected<size_t> try_read( char * const buffer, const size_t length );
+  Expected<size_t> try_write( const char * const data, const size_t length );
+
   /* forbid copying FileDescriptor objects or assigning them */
   FileDescriptor( const FileDescriptor & other ) = delete;
   const FileDescriptor & operator=( const FileDescriptor & other ) = delete;
@@ -0,0 +1,679 @@
+#include <cstring>
+#include <stdexcept>
+
+#include "config.h"
+#include "io_uring.hh"
+#include "util.hh"
+
+using namespace std;
+
+#ifdef HAVE_LINUX_IO_URING_H
+
+#include <csignal>
+#include <linux/io_uring.h>
+#include <linux/time_types.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/* room for the source address and ancillary data (timestamps, receive
+   offload) at the front of each buffer a multishot receive fills */
+static const socklen_t RECEIVE_NAME = sizeof( Address::raw );
+static const socklen_t RECEIVE_CONTROL = 128;
+
+/* the io_uring syscalls, which glibc doesn't wrap */
+static int io_uring_setup( const unsigned int entries, io_uring_params & params )
+{
+  return syscall( __NR_io_uring_setup, entries, &params );
+}
+
+static int io_uring_register( const int fd, const unsigned int opcode, const void * const arg,
+			      const unsigned int nr_args )
+{
+  return syscall( __NR_io_uring_register, fd, opcode, arg, nr_args );
+}
+
+/* the ring's indices are shared with the kernel */
+static unsigned load_acquire( const unsigned * const p ) { return __atomic_load_n( p, __ATOMIC_ACQUIRE ); }
+static void store_release( unsigned * const p, const unsigned v ) { __atomic_store_n( p, v, __ATOMIC_RELEASE ); }
+
+/* map memory shared with the kernel (or, with fd -1, memory to register with it) */
+static void * map( const size_t size, const int fd, const off_t offset )
+{
+  void * const mapping = mmap( nullptr, size, PROT_READ | PROT_WRITE,
+			       fd < 0 ? MAP_PRIVATE | MAP_ANONYMOUS : MAP_SHARED | MAP_POPULATE,
+			       fd, offset );
+  if ( mapping == MAP_FAILED ) {
+    throw unix_error( "mmap" );
+  }
+  return mapping;
+}
+
+struct IOUring::Setup
+{
+  io_uring_params params;
+  int fd;
+
+  Setup( const unsigned int entries )
+    : params(), fd()
+  {
+    zero( params );
+
+    /* completions can outnumber submissions (multishot receives) */
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = 8 * entries;
+
+    fd = SystemCall( "io_uring_setup", io_uring_setup( entries, params ) );
+  }
+};
+
+IOUring::IOUring( const unsigned int entries, const unsigned int slot_count, const size_t slot_size )
+  : IOUring( Setup( entries ), slot_count, slot_size )
+{}
+
+IOUring::IOUring( const Setup & setup, const unsigned int slot_count, const size_t slot_size )
+  : FileDescriptor( setup.fd ),
+    ring_mapping_( nullptr ),
+    ring_mapping_size_( 0 ),
+    sqe_mapping_( nullptr ),
+    sqe_mapping_size_( 0 ),
+    sq_(),
+    cq_(),
+    sq_tail_( 0 ),
+    unsubmitted_( 0 ),
+    slots_( nullptr ),
+    slot_size_( slot_size ),
+    slot_count_( slot_count ),
+    free_slots_(),
+    buffer_groups_(),
+    operations_(),
+    free_operations_(),
+    received_(),
+    truncated_count_( 0 )
+{
+  const io_uring_params & params = setup.params;
+
+  if ( not (params.features & IORING_FEAT_SINGLE_MMAP) or not (params.features & IORING_FEAT_EXT_ARG) ) {
+    throw runtime_error( "io_uring: kernel too old (needs Linux 5.11 or later)" );
+  }
+
+  /* the submission and completion rings share one mapping */
+  ring_mapping_size_ = max( params.sq_off.array + params.sq_entries * sizeof( unsigned ),
+			    params.cq_off.cqes + params.cq_entries * sizeof( io_uring_cqe ) );
+  ring_mapping_ = map( ring_mapping_size_, fd_num(), IORING_OFF_SQ_RING );
+  char * const ring = static_cast<char *>( ring_mapping_ );
+
+  sqe_mapping_size_ = params.sq_entries * sizeof( io_uring_sqe );
+  sqe_mapping_ = map( sqe_mapping_size_, fd_num(), IORING_OFF_SQES );
+
+  sq_.head = reinterpret_cast<unsigned *>( ring + params.sq_off.head );
+  sq_.tail = reinterpret_cast<unsigned *>( ring + params.sq_off.tail );
+  sq_.mask = reinterpret_cast<unsigned *>( ring + params.sq_off.ring_mask );
+  sq_.array = reinterpret_cast<unsigned *>( ring + params.sq_off.array );
+  sq_.entries = params.sq_entries;
+  sq_.sqes = sqe_mapping_;
+
+  cq_.head = reinterpret_cast<unsigned *>( ring + params.cq_off.head );
+  cq_.tail = reinterpret_cast<unsigned *>( ring + params.cq_off.tail );
+  cq_.mask = reinterpret_cast<unsigned *>( ring + params.cq_off.ring_mask );
+  cq_.cqes = ring + params.cq_off.cqes;
+
+  /* submission entry i always sits in slot i of the indirection array */
+  for ( unsigned i = 0; i < sq_.entries; i++ ) {
+    sq_.array[ i ] = i;
+  }
+  sq_tail_ = *sq_.tail;
+
+  /* register the send/write buffers as one region */
+  slots_ = static_cast<char *>( map( slot_count_ * slot_size_, -1, 0 ) );
+  const iovec region = { slots_, slot_count_ * slot_size_ };
+  SystemCall( "io_uring_register buffers",
+	      io_uring_register( fd_num(), IORING_REGISTER_BUFFERS, &region, 1 ) );
+
+  for ( unsigned int i = slot_count_; i-- > 0; ) {
+    free_slots_.push_back( i );
+  }
+}
+
+IOUring::~IOUring()
+{
+  for ( const auto & group : buffer_groups_ ) {
+    munmap( group.ring, group.count * sizeof( io_uring_buf ) );
+    munmap( group.buffers, group.count * group.size );
+  }
+
+  if ( slots_ ) {
+    munmap( slots_, slot_count_ * slot_size_ );
+  }
+  if ( sqe_mapping_ ) {
+    munmap( sqe_mapping_, sqe_mapping_size_ );
+  }
+  if ( ring_mapping_ ) {
+    munmap( ring_mapping_, ring_mapping_size_ );
+  }
+}
+
+/* does the kernel know every opcode used here? */
+static bool opcodes_supported( const int fd )
+{
+  const unsigned int op_count = 256;
+  vector<char> storage( sizeof( io_uring_probe ) + op_count * sizeof( io_uring_probe_op ) );
+  io_uring_probe * const probe = reinterpret_cast<io_uring_probe *>( storage.data() );
+
+  if ( io_uring_register( fd, IORING_REGISTER_PROBE, probe, op_count ) < 0 ) {
+    return false;
+  }
+
+  for ( const unsigned int opcode : { IORING_OP_SEND, IORING_OP_SENDMSG, IORING_OP_RECVMSG,
+				      IORING_OP_READ_FIXED, IORING_OP_WRITE_FIXED } ) {
+    if ( opcode >= probe->ops_len or not (probe->ops[ opcode ].flags & IO_URING_OP_SUPPORTED) ) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/* can buffer rings be provided (Linux 5.19)? There is no probe, so register one */
+static bool buffer_rings_supported( const int fd )
+{
+  const size_t size = sizeof( io_uring_buf );
+  void * const ring = map( size, -1, 0 );
+
+  io_uring_buf_reg registration;
+  zero( registration );
+  registration.ring_addr = reinterpret_cast<uint64_t>( ring );
+  registration.ring_entries = 1;
+
+  const bool registered = io_uring_register( fd, IORING_REGISTER_PBUF_RING, &registration, 1 ) == 0;
+  if ( registered ) {
+    io_uring_register( fd, IORING_UNREGISTER_PBUF_RING, &registration, 1 );
+  }
+
+  munmap( ring, size );
+  return registered;
+}
+
+bool IOUring::supported()
+{
+  static const bool answer = [] () {
+    try {
+      io_uring_params params;
+      zero( params );
+      const int fd = io_uring_setup( 2, params );
+      if ( fd < 0 ) {
+	return false;
+      }
+
+      /* timed waits need EXT_ARG (5.11) */
+      const bool basics = (params.features & IORING_FEAT_SINGLE_MMAP)
+	and (params.features & IORING_FEAT_EXT_ARG)
+	and opcodes_supported( fd ) and buffer_rings_supported( fd );
+      close( fd );
+      if ( not basics ) {
+	return false;
+      }
+
+      /* Multishot receives (6.0) can't be probed either (recvmsg itself
+	 is older): receive a datagram with one, which fails on an older
+	 kernel with EINVAL */
+      UDPSocket receiver, sender;
+      receiver.bind( Address( "127.0.0.1", uint16_t( 0 ) ) );
+      sender.connect( receiver.local_address() );
+      sender.send( "io_uring probe" );
+
+      IOUring ring( 4, 1, 64 );
+      bool received = false;
+      ring.recv_multishot( receiver, [&received] ( UDPSocket::received_datagram & ) {
+	  received = true;
+	}, 2, 2048 );
+
+      for ( unsigned int i = 0; i < 10 and not received; i++ ) {
+	ring.wait( 100000 );
+      }
+
+      return received;
+    } catch ( const exception & ) {
+      return false;
+    }
+  }();
+
+  return answer;
+}
+
+size_t IOUring::new_operation( const char * const name, const Handler & done, const int slot )
+{
+  size_t index;
+  if ( free_operations_.empty() ) {
+    index = operations_.size();
+    operations_.emplace_back();
+  } else {
+    index = free_operations_.back();
+    free_operations_.pop_back();
+  }
+
+  Operation & operation = operations_[ index ];
+  operation.name = name;
+  operation.done = done;
+  operation.slot = slot;
+  operation.received = DatagramHandler();
+  operation.socket = -1;
+  return index;
+}
+
+void IOUring::release( const size_t index )
+{
+  Operation & operation = operations_[ index ];
+  if ( operation.slot >= 0 ) {
+    free_slots_.push_back( operation.slot );
+  }
+  operation.done = Handler();
+  free_operations_.push_back( index );
+}
+
+/* a free registered buffer, waiting for sends in flight to finish if need be */
+unsigned int IOUring::acquire_slot()
+{
+  while ( free_slots_.empty() ) {
+    wait();
+  }
+
+  const unsigned int index = free_slots_.back();
+  free_slots_.pop_back();
+  return index;
+}
+
+void * IOUring::next_sqe( const size_t index )
+{
+  /* if the submission ring is full, hand it to the kernel first */
+  if ( sq_tail_ - load_acquire( sq_.head ) >= sq_.entries ) {
+    submit();
+  }
+
+  io_uring_sqe * const sqe = static_cast<io_uring_sqe *>( sq_.sqes ) + (sq_tail_ & *sq_.mask);
+  zero( *sqe );
+  sqe->user_data = index;
+
+  /* (the kernel sees it once submit() publishes the new tail) */
+  sq_tail_++;
+  unsubmitted_++;
+  return sqe;
+}
+
+void IOUring::send( UDPSocket & socket, const char * const data, const size_t length,
+		    const Handler & done )
+{
+  if ( length > slot_size_ ) {
+    throw runtime_error( "io_uring send: datagram larger than a registered buffer" );
+  }
+
+  const unsigned int buffer = acquire_slot();
+  memcpy( slot( buffer ), data, length );
+  const size_t index = new_operation( "io_uring send", done, buffer );
+
+  io_uring_sqe * const sqe = static_cast<io_uring_sqe *>( next_sqe( index ) );
+  sqe->opcode = IORING_OP_SEND;
+  sqe->fd = socket.fd_num();
+  sqe->addr = reinterpret_cast<uint64_t>( slot( buffer ) );
+  sqe->len = length;
+}
+
+void IOUring::sendto( UDPSocket & socket, const Address & destination,
+		      const char * const data, const size_t length,
+		      const Handler & done )
+{
+  if ( length > slot_size_ ) {
+    throw runtime_error( "io_uring sendto: datagram larger than a registered buffer" );
+  }
+
+  const unsigned int buffer = acquire_slot();
+  memcpy( slot( buffer ), data, length );
+  const size_t index = new_operation( "io_uring sendmsg", done, buffer );
+  Operation & operation = operations_[ index ];
+
+  memcpy( &operation.address, &destination.to_sockaddr(), destination.size() );
+  operation.data.iov_base = slot( buffer );
+  operation.data.iov_len = length;
+  zero( operation.header );
+  operation.header.msg_name = &operation.address;
+  operation.header.msg_namelen = destination.size();
+  operation.header.msg_iov = &operation.data;
+  operation.header.msg_iovlen = 1;
+
+  io_uring_sqe * const sqe = static_cast<io_uring_sqe *>( next_sqe( index ) );
+  sqe->opcode = IORING_OP_SENDMSG;
+  sqe->fd = socket.fd_num();
+  sqe->addr = reinterpret_cast<uint64_t>( &operation.header );
+  sqe->len = 1;
+}
+
+void IOUring::recv_multishot( UDPSocket & socket, const DatagramHandler & received,
+			      const unsigned int buffer_count, const size_t buffer_size )
+{
+  if ( buffer_count == 0 or (buffer_count & (buffer_count - 1)) or buffer_count > 32768 ) {
+    throw runtime_error( "io_uring recv_multishot: buffer count must be a power of two up to 32768" );
+  }
+
+  if ( buffer_size <= sizeof( io_uring_recvmsg_out ) + RECEIVE_NAME + RECEIVE_CONTROL ) {
+    throw runtime_error( "io_uring recv_multishot: buffers too small" );
+  }
+
+  /* provide a ring of buffers to the kernel, as a new group */
+  BufferGroup group = { map( buffer_count * sizeof( io_uring_buf ), -1, 0 ),
+			static_cast<char *>( map( buffer_count * buffer_size, -1, 0 ) ),
+			buffer_count, buffer_size, 0 };
+
+  io_uring_buf_reg registration;
+  zero( registration );
+  registration.ring_addr = reinterpret_cast<uint64_t>( group.ring );
+  registration.ring_entries = buffer_count;
+  registration.bgid = buffer_groups_.size();
+
+  const int ret = io_uring_register( fd_num(), IORING_REGISTER_PBUF_RING, &registration, 1 );
+  if ( ret < 0 ) {
+    munmap( group.ring, buffer_count * sizeof( io_uring_buf ) );
+    munmap( group.buffers, buffer_count * buffer_size );
+    throw unix_error( "io_uring_register pbuf_ring" );
+  }
+
+  buffer_groups_.push_back( group );
+  for ( unsigned int i = 0; i < buffer_count; i++ ) {
+    recycle( buffer_groups_.back(), i );
+  }
+
+  const size_t index = new_operation( "io_uring recvmsg", Handler(), -1 );
+  Operation & operation = operations_[ index ];
+  operation.received = received;
+  operation.socket = socket.fd_num();
+  operation.buffer_group = registration.bgid;
+
+  /* the kernel puts the address and ancillary data at the front of each buffer */
+  zero( operation.header );
+  operation.header.msg_namelen = RECEIVE_NAME;
+  operation.header.msg_controllen = RECEIVE_CONTROL;
+
+  arm_multishot( index );
+}
+
+void IOUring::arm_multishot( const size_t index )
+{
+  Operation & operation = operations_[ index ];
+
+  io_uring_sqe * const sqe = static_cast<io_uring_sqe *>( next_sqe( index ) );
+  sqe->opcode = IORING_OP_RECVMSG;
+  sqe->fd = operation.socket;
+  sqe->addr = reinterpret_cast<uint64_t>( &operation.header );
+  sqe->len = 1;
+  sqe->flags = IOSQE_BUFFER_SELECT;
+  sqe->buf_group = operation.buffer_group;
+  sqe->ioprio = IORING_RECV_MULTISHOT;
+}
+
+/* give a buffer back to the kernel */
+void IOUring::recycle( BufferGroup & group, const uint16_t buffer_id )
+{
+  /* the ring is an array of io_uring_buf whose first resv field is the
+     tail (not struct io_uring_buf_ring, whose flexible array member
+     lands 8 bytes in when compiled as C++) */
+  io_uring_buf * const ring = static_cast<io_uring_buf *>( group.ring );
+  io_uring_buf & buffer = ring[ group.tail & (group.count - 1) ];
+  buffer.addr = reinterpret_cast<uint64_t>( group.buffers + buffer_id * group.size );
+  buffer.len = group.size;
+  buffer.bid = buffer_id;
+
+  group.tail++;
+  __atomic_store_n( &ring[ 0 ].resv, group.tail, __ATOMIC_RELEASE );
+}
+
+/* hand the datagrams in a filled buffer to the receive's handler */
+void IOUring::deliver( Operation & operation, const Completion & completion, const uint16_t buffer_id )
+{
+  BufferGroup & group = buffer_groups_.at( operation.buffer_group );
+  char * const buffer = group.buffers + buffer_id * group.size;
+
+  /* the buffer holds a header, the address, the ancillary data, then the payload */
+  const io_uring_recvmsg_out * const out = reinterpret_cast<io_uring_recvmsg_out *>( buffer );
+  char * const name = buffer + sizeof( *out );
+  char * const control = name + RECEIVE_NAME;
+  const char * const payload = control + RECEIVE_CONTROL;
+
+  msghdr header;
+  zero( header );
+  header.msg_name = name;
+  header.msg_namelen = min( out->namelen, uint32_t( RECEIVE_NAME ) );
+  header.msg_control = control;
+  header.msg_controllen = out->controllen;
+  header.msg_flags = out->flags;
+
+  if ( completion.result < int32_t( sizeof( *out ) + RECEIVE_NAME + RECEIVE_CONTROL ) ) {
+    recycle( group, buffer_id );
+    throw runtime_error( "io_uring recvmsg: short buffer" );
+  }
+
+  /* a datagram too big for the buffer is dropped (and counted), as
+     UDPSocket::recv_batch() does */
+  if ( out->flags & MSG_TRUNC ) {
+    truncated_count_++;
+    recycle( group, buffer_id );
+    return;
+  }
+
+  /* the kernel reports the datagram's full length, even if it was truncated */
+  const size_t room = completion.result - (payload - buffer);
+  const size_t length = min( size_t( out->payloadlen ), room );
+
+  /* take the storage while the handlers run (one that waits for a free
+     slot delivers more datagrams from inside this call) */
+  vector<UDPSocket::received_datagram> datagrams;
+  datagrams.swap( received_ );
+  const size_t count = UDPSocket::unpack_received( header, payload, length, datagrams, 0 );
+
+  /* the datagrams have been copied out, so the buffer can go back at once */
+  recycle( group, buffer_id );
+
+  for ( size_t i = 0; i < count; i++ ) {
+    operation.received( datagrams[ i ] );
+  }
+
+  datagrams.swap( received_ );
+}
+
+void IOUring::read( FileDescriptor & fd, const size_t limit,
+		    const function<void( const char * data, const size_t length )> & done )
+{
+  const unsigned int buffer = acquire_slot();
+  const char * const data = slot( buffer );
+
+  const size_t index = new_operation( "io_uring read", [done, data] ( const Completion & completion ) {
+      if ( completion.result < 0 ) {
+	throw unix_error( "io_uring read", -completion.result );
+      }
+      done( data, completion.result );
+    }, buffer );
+
+  io_uring_sqe * const sqe = static_cast<io_uring_sqe *>( next_sqe( index ) );
+  sqe->opcode = IORING_OP_READ_FIXED;
+  sqe->fd = fd.fd_num();
+  sqe->off = -1; /* the current position */
+  sqe->addr = reinterpret_cast<uint64_t>( data );
+  sqe->len = min( limit, slot_size_ );
+  sqe->buf_index = 0;
+}
+
+void IOUring::write( FileDescriptor & fd, const string & buffer, const Handler & done )
+{
+  if ( buffer.empty() ) {
+    throw runtime_error( "nothing to write" );
+  }
+
+  write_from( fd, make_shared<string>( buffer ), 0, done );
+}
+
+/* write one slot's worth; its completion queues the next */
+void IOUring::write_from( FileDescriptor & fd, const shared_ptr<string> & buffer,
+			  const size_t offset, const Handler & done )
+{
+  const unsigned int chunk = acquire_slot();
+  const size_t length = min( slot_size_, buffer->size() - offset );
+  memcpy( slot( chunk ), buffer->data() + offset, length );
+
+  const size_t index = new_operation( "io_uring write", [this, &fd, buffer, offset, done] ( const Completion & completion ) {
+      if ( completion.result <= 0 ) {
+	if ( done ) {
+	  done( completion );
+	  return;
+	}
+	throw unix_error( "io_uring write", completion.result ? -completion.result : EIO );
+      }
+
+      const size_t written = offset + completion.result;
+      if ( written < buffer->size() ) {
+	write_from( fd, buffer, written, done );
+      } else if ( done ) {
+	done( { int32_t( written ), 0 } );
+      }
+    }, chunk );
+
+  io_uring_sqe * const sqe = static_cast<io_uring_sqe *>( next_sqe( index ) );
+  sqe->opcode = IORING_OP_WRITE_FIXED;
+  sqe->fd = fd.fd_num();
+  sqe->off = -1;
+  sqe->addr = reinterpret_cast<uint64_t>( slot( chunk ) );
+  sqe->len = length;
+  sqe->buf_index = 0;
+}
+
+int IOUring::enter( const unsigned int to_submit, const unsigned int min_complete,
+		    const int64_t timeout_us )
+{
+  unsigned int flags = min_complete ? IORING_ENTER_GETEVENTS : 0;
+
+  __kernel_timespec timeout;
+  io_uring_getevents_arg arg;
+  zero( arg );
+  if ( min_complete and timeout_us >= 0 ) {
+    timeout.tv_sec = timeout_us / 1000000;
+    timeout.tv_nsec = (timeout_us % 1000000) * 1000;
+    arg.sigmask_sz = _NSIG / 8;
+    arg.ts = reinterpret_cast<uint64_t>( &timeout );
+    flags |= IORING_ENTER_EXT_ARG;
+  }
+
+  /* publish what has been queued */
+  store_release( sq_.tail, sq_tail_ );
+
+  const int ret = syscall( __NR_io_uring_enter, fd_num(), to_submit, min_complete, flags,
+			   flags & IORING_ENTER_EXT_ARG ? static_cast<void *>( &arg ) : nullptr,
+			   flags & IORING_ENTER_EXT_ARG ? sizeof( arg ) : 0 );
+
+  if ( ret < 0 and (errno == ETIME or errno == EINTR) ) {
+    return 0;
+  }
+
+  const int submitted = SystemCall( "io_uring_enter", ret );
+  unsubmitted_ -= submitted;
+  return submitted;
+}
+
+void IOUring::submit()
+{
+  while ( unsubmitted_ ) {
+    enter( unsubmitted_, 0, -1 );
+  }
+}
+
+size_t IOUring::wait( const int64_t timeout_us )
+{
+  /* submit and wait in one syscall; what the handlers queue goes out with the next */
+  const bool ready = load_acquire( cq_.head ) != load_acquire( cq_.tail );
+  if ( unsubmitted_ or not ready ) {
+    enter( unsubmitted_, ready ? 0 : 1, timeout_us );
+  }
+
+  return handle_completions();
+}
+
+size_t IOUring::reap()
+{
+  const size_t handled = handle_completions();
+
+  if ( unsubmitted_ ) {
+    submit();
+  }
+
+  return handled;
+}
+
+size_t IOUring::handle_completions()
+{
+  size_t handled = 0;
+
+  /* (handlers may queue operations, or even wait, so take one entry at a time) */
+  while ( true ) {
+    const unsigned head = *cq_.head;
+    if ( head == load_acquire( cq_.tail ) ) {
+      break;
+    }
+
+    const io_uring_cqe & cqe = static_cast<io_uring_cqe *>( cq_.cqes )[ head & *cq_.mask ];
+    const size_t index = cqe.user_data;
+    const Completion completion = { cqe.res, cqe.flags };
+    store_release( cq_.head, head + 1 );
+    handled++;
+
+    Operation & operation = operations_.at( index );
+
+    if ( operation.received ) {
+      /* a multishot receive: deliver, and rearm if the kernel has stopped it */
+      if ( completion.result >= 0 and (completion.flags & IORING_CQE_F_BUFFER) ) {
+	deliver( operation, completion, completion.flags >> IORING_CQE_BUFFER_SHIFT );
+      } else if ( completion.result < 0 and completion.result != -ENOBUFS ) {
+	throw unix_error( operation.name, -completion.result );
+      }
+
+      if ( not (completion.flags & IORING_CQE_F_MORE) ) {
+	arm_multishot( index );
+      }
+      continue;
+    }
+
+    /* a one-shot operation: free it before its handler runs (and maybe queues more) */
+    const Handler done = operation.done;
+    const char * const name = operation.name;
+    release( index );
+
+    if ( done ) {
+      done( completion );
+    } else if ( completion.result < 0 ) {
+      throw unix_error( name, -completion.result );
+    }
+  }
+
+  register_read();
+  return handled;
+}
+
+#else /* no io_uring headers: supported() says so, and the rest refuses */
+
+IOUring::IOUring( const unsigned int, const unsigned int, const size_t )
+  : FileDescriptor( -1 ), ring_mapping_( nullptr ), ring_mapping_size_( 0 ),
+    sqe_mapping_( nullptr ), sqe_mapping_size_( 0 ), sq_(), cq_(), sq_tail_( 0 ),
+    unsubmitted_( 0 ), slots_( nullptr ), slot_size_( 0 ), slot_count_( 0 ), free_slots_(),
+    buffer_groups_(), operations_(), free_operations_(), received_(), truncated_count_( 0 )
+{
+  throw runtime_error( "io_uring: not available in this build" );
+}
+
+IOUring::~IOUring() {}
+bool IOUring::supported() { return false; }
+void IOUring::send( UDPSocket &, const char * const, const size_t, const Handler & ) {}
+void IOUring::sendto( UDPSocket &, const Address &, const char * const, const size_t, const Handler & ) {}
+void IOUring::recv_multishot( UDPSocket &, const DatagramHandler &, const unsigned int, const size_t ) {}
+void IOUring::read( FileDescriptor &, const size_t, const function<void( const char *, const size_t )> & ) {}
+void IOUring::write( FileDescriptor &, const string &, const Handler & ) {}
+void IOUring::submit() {}
+size_t IOUring::wait( const int64_t ) { return 0; }
+size_t IOUring::reap() { return 0; }
+size_t IOUring::handle_completions() { return 0; }
+
+#endif /* HAVE_LINUX_IO_URING_H */
@@ -0,0 +1,204 @@
+#ifndef IO_URING_HH
+#define IO_URING_HH
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <sys/socket.h>
+
+#include "file_descriptor.hh"
+#include "socket.hh"
+
+/* An io_uring instance (set up with raw syscalls): operations are queued
+   in a ring shared with the kernel and their completions come back in
+   another, so many sends and receives cost one io_uring_enter() between
+   them, or none at all.
+
+   The ring is itself a file descriptor, readable while completions are
+   waiting, so it can join a Poller: an action on it that calls reap()
+   runs each operation's handler. Or wait() can run a loop on its own.
+
+   Data to send or write is copied into a pool of buffers registered with
+   the kernel (so the caller's buffer can be reused at once), and
+   multishot receives draw from rings of buffers provided to the kernel,
+   so one submission keeps delivering datagrams. */
+
+class IOUring : public FileDescriptor
+{
+public:
+  /* what the kernel reported for one operation */
+  struct Completion
+  {
+    int32_t result; /* what the equivalent syscall would return, or -errno */
+    uint32_t flags;
+  };
+
+  /* called with each completion; without one, errors are thrown from reap() */
+  typedef std::function<void( const Completion & )> Handler;
+
+  /* called with each datagram a multishot receive delivers */
+  typedef std::function<void( UDPSocket::received_datagram & )> DatagramHandler;
+
+  /* entries: room in the submission ring; slot_count buffers of
+     slot_size bytes each are registered for sends and writes */
+  IOUring( const unsigned int entries = 256,
+	   const unsigned int slot_count = 256, const size_t slot_size = 2048 );
+  ~IOUring();
+
+  /* can this kernel run everything below (multishot receive, provided
+     buffer rings and timed waits, which arrived by Linux 6.0)? Probes
+     the opcodes, registers a trial buffer ring and receives a datagram
+     with a multishot receive, once per process. */
+  static bool supported();
+
+  /* send a datagram to a connected socket's peer */
+  void send( UDPSocket & socket, const char * const data, const size_t length,
+	     const Handler & done = Handler() );
+
+  /* send a datagram to a given address */
+  void sendto( UDPSocket & socket, const Address & destination,
+	       const char * const data, const size_t length,
+	       const Handler & done = Handler() );
+
+  /* receive datagrams on socket until it fails, each handed to received
+     with its source address and timestamp (as with UDPSocket::recv_batch()).
+     Draws from buffer_count buffers of buffer_size bytes, which must hold
+     a whole datagram (or buffer, with receive offload) plus about 300 bytes
+     of address and ancillary data; if they run out, receiving resumes as
+     they are recycled. A datagram too big for its buffer is dropped. */
+  void recv_multishot( UDPSocket & socket, const DatagramHandler & received,
+		       const unsigned int buffer_count = 1024, const size_t buffer_size = 2048 );
+
+  /* how many received datagrams were dropped for not fitting their buffer */
+  uint64_t truncated_count() const { return truncated_count_; }
+
+  /* read up to limit bytes (at most one slot) from fd's current position
+     into a registered buffer; done gets the data (length 0 at EOF) */
+  void read( FileDescriptor & fd, const size_t limit,
+	     const std::function<void( const char * data, const size_t length )> & done );
+
+  /* write all of buffer to fd, a slot at a time; done gets the total written */
+  void write( FileDescriptor & fd, const std::string & buffer, const Handler & done = Handler() );
+
+  /* operations queued but not yet handed to the kernel */
+  unsigned int unsubmitted() const { return unsubmitted_; }
+
+  /* hand queued operations to the kernel, without waiting */
+  void submit();
+
+  /* submit, then wait (up to timeout_us, or forever if negative) for at
+     least one completion, and run the handlers; what they queue goes out
+     with the next wait() (in the same syscall). Returns how many
+     completions were handled. */
+  size_t wait( const int64_t timeout_us = -1 );
+
+  /* run the handler of every completion waiting, then submit whatever
+     they (and multishot receives that need rearming) queued; returns how
+     many completions were handled */
+  size_t reap();
+
+  /* forbid copying or assigning */
+  IOUring( const IOUring & other ) = delete;
+  IOUring & operator=( const IOUring & other ) = delete;
+
+private:
+  /* the ring's fd and its layout, as io_uring_setup() reported them */
+  struct Setup;
+  IOUring( const Setup & setup, const unsigned int slot_count, const size_t slot_size );
+
+  /* the shared rings, as mapped */
+  struct SubmissionRing
+  {
+    unsigned * head, * tail, * mask, * array;
+    unsigned entries;
+    void * sqes;
+  };
+
+  struct CompletionRing
+  {
+    unsigned * head, * tail, * mask;
+    void * cqes;
+  };
+
+  void * ring_mapping_;
+  size_t ring_mapping_size_;
+  void * sqe_mapping_;
+  size_t sqe_mapping_size_;
+  SubmissionRing sq_;
+  CompletionRing cq_;
+  unsigned sq_tail_; /* our copy: next submission entry to fill */
+  unsigned unsubmitted_;
+
+  /* registered buffers for sends and writes */
+  char * slots_;
+  size_t slot_size_;
+  unsigned int slot_count_;
+  std::vector<unsigned int> free_slots_;
+
+  /* a ring of buffers provided to the kernel for one multishot receive */
+  struct BufferGroup
+  {
+    void * ring; /* struct io_uring_buf_ring */
+    char * buffers;
+    unsigned int count;
+    size_t size;
+    uint16_t tail;
+  };
+  std::deque<BufferGroup> buffer_groups_;
+
+  /* an operation in flight (indexed by the user_data the kernel echoes) */
+  struct Operation
+  {
+    const char * name; /* for errors */
+    Handler done;
+    int slot; /* registered buffer in use, or -1 */
+
+    /* sendmsg() and recvmsg() arguments, which must stay put until the kernel is done */
+    msghdr header;
+    iovec data;
+    Address::raw address;
+
+    /* multishot receives: where to deliver, and how to rearm */
+    DatagramHandler received;
+    int socket;
+    unsigned int buffer_group;
+
+    Operation()
+      : name( "" ), done(), slot( -1 ), header(), data(), address(),
+	received(), socket( -1 ), buffer_group( 0 ) {}
+
+    /* (its msghdr points into itself) */
+    Operation( const Operation & other ) = delete;
+    Operation & operator=( const Operation & other ) = delete;
+  };
+  std::deque<Operation> operations_; /* (a deque, so addresses are stable) */
+  std::vector<size_t> free_operations_;
+
+  /* datagrams unpacked from one received buffer (storage reused) */
+  std::vector<UDPSocket::received_datagram> received_;
+
+  uint64_t truncated_count_;
+
+  size_t new_operation( const char * const name, const Handler & done, const int slot );
+  void release( const size_t index );
+  unsigned int acquire_slot();
+  char * slot( const unsigned int index ) { return slots_ + index * slot_size_; }
+
+  /* the next free submission entry, zeroed, for operation index */
+  void * next_sqe( const size_t index );
+
+  void arm_multishot( const size_t index );
+  void recycle( BufferGroup & group, const uint16_t buffer_id );
+  void deliver( Operation & operation, const Completion & completion, const uint16_t buffer_id );
+  size_t handle_completions();
+  void write_from( FileDescriptor & fd, const std::shared_ptr<std::string> & buffer,
+		   const size_t offset, const Handler & done );
+  int enter( const unsigned int to_submit, const unsigned int min_complete,
+	     const int64_t timeout_us );
+};
+
+#endif /* IO_URING_HH */
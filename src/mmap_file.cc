@@ -0,0 +1,38 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "mmap_file.hh"
+#include "util.hh"
+
+using namespace std;
+
+MappedFile::MappedFile( const string & filename )
+  : fd_( SystemCall( "open " + filename, open( filename.c_str(), O_RDONLY | O_CLOEXEC ) ) ),
+    size_( 0 ),
+    data_( nullptr )
+{
+  struct stat info;
+  SystemCall( "fstat", fstat( fd_.fd_num(), &info ) );
+  size_ = info.st_size;
+
+  if ( size_ == 0 ) {
+    return; /* mmap() refuses empty mappings */
+  }
+
+  void * const mapping = mmap( nullptr, size_, PROT_READ, MAP_PRIVATE, fd_.fd_num(), 0 );
+  if ( mapping == MAP_FAILED ) {
+    throw unix_error( "mmap " + filename );
+  }
+  data_ = static_cast<const char *>( mapping );
+
+  /* it will be read front to back: ask for generous readahead */
+  madvise( mapping, size_, MADV_SEQUENTIAL );
+}
+
+MappedFile::~MappedFile()
+{
+  if ( data_ ) {
+    munmap( const_cast<char *>( data_ ), size_ );
+  }
+}
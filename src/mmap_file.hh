@@ -0,0 +1,28 @@
+#ifndef MMAP_FILE_HH
+#define MMAP_FILE_HH
+
+#include <string>
+
+#include "file_descriptor.hh"
+
+/* a whole file mapped read-only into memory */
+class MappedFile
+{
+private:
+  FileDescriptor fd_;
+  size_t size_;
+  const char * data_;
+
+public:
+  MappedFile( const std::string & filename );
+  ~MappedFile();
+
+  const char * data() const { return data_; }
+  size_t size() const { return size_; }
+
+  /* forbid copying or assigning */
+  MappedFile( const MappedFile & other ) = delete;
+  MappedFile & operator=( const MappedFile & other ) = delete;
+};
+
+#endif /* MMAP_FILE_HH */
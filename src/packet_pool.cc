@@ -0,0 +1,74 @@
+#include <algorithm>
+#include <cstdlib>
+
+#include "packet_pool.hh"
+#include "util.hh"
+
+using namespace std;
+
+PacketPool::PacketPool( const size_t buffer_size, const size_t buffers_per_slab )
+  : buffer_size_( (max( buffer_size, size_t( 1 ) ) + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE ),
+    buffers_per_slab_( max( buffers_per_slab, size_t( 1 ) ) ),
+    slabs_(),
+    free_()
+{}
+
+PacketPool::~PacketPool()
+{
+  for ( auto & slab : slabs_ ) {
+    free( slab );
+  }
+}
+
+/* add a slab's worth of buffers to the free list */
+void PacketPool::grow()
+{
+  void * slab;
+  const int ret = posix_memalign( &slab, CACHE_LINE, buffer_size_ * buffers_per_slab_ );
+  if ( ret ) {
+    throw unix_error( "posix_memalign", ret );
+  }
+  slabs_.push_back( static_cast<char *>( slab ) );
+
+  /* push in reverse, so the slab is handed out front to back */
+  free_.reserve( capacity() );
+  for ( size_t i = buffers_per_slab_; i > 0; i-- ) {
+    free_.push_back( slabs_.back() + (i - 1) * buffer_size_ );
+  }
+}
+
+PacketPool::Buffer PacketPool::get()
+{
+  if ( free_.empty() ) {
+    grow();
+  }
+
+  char * const data = free_.back();
+  free_.pop_back();
+  return Buffer( *this, data );
+}
+
+PacketPool::Buffer::Buffer( Buffer && other )
+  : pool_( other.pool_ ), data_( other.data_ )
+{
+  other.data_ = nullptr;
+}
+
+PacketPool::Buffer & PacketPool::Buffer::operator=( Buffer && other )
+{
+  if ( this != &other ) {
+    reset();
+    pool_ = other.pool_;
+    data_ = other.data_;
+    other.data_ = nullptr;
+  }
+  return *this;
+}
+
+void PacketPool::Buffer::reset()
+{
+  if ( data_ ) {
+    pool_->free_.push_back( data_ );
+    data_ = nullptr;
+  }
+}
@@ -0,0 +1,68 @@
+#ifndef PACKET_POOL_HH
+#define PACKET_POOL_HH
+
+#include <cstddef>
+#include <vector>
+
+/* Fixed-size packet buffers, carved out of cache-aligned slabs and
+   recycled through a free list: once the pool has grown to cover the
+   packets in use at once, taking and returning a buffer allocates
+   nothing. Not thread-safe (give each thread its own pool), and every
+   buffer must be returned before the pool is destroyed. */
+class PacketPool
+{
+public:
+  static const size_t CACHE_LINE = 64;
+
+  /* a buffer on loan from the pool, returned when the handle is destroyed */
+  class Buffer
+  {
+  private:
+    PacketPool * pool_;
+    char * data_;
+
+  public:
+    Buffer() : pool_( nullptr ), data_( nullptr ) {}
+    Buffer( PacketPool & pool, char * const data ) : pool_( &pool ), data_( data ) {}
+    ~Buffer() { reset(); }
+
+    Buffer( Buffer && other );
+    Buffer & operator=( Buffer && other );
+
+    /* hand the buffer back to its pool early */
+    void reset();
+
+    char * data() const { return data_; }
+    size_t capacity() const { return pool_ ? pool_->buffer_size() : 0; }
+    explicit operator bool() const { return data_ != nullptr; }
+
+    /* forbid copying or assigning */
+    Buffer( const Buffer & other ) = delete;
+    Buffer & operator=( const Buffer & other ) = delete;
+  };
+
+  /* buffer_size is rounded up to whole cache lines */
+  PacketPool( const size_t buffer_size = 2048, const size_t buffers_per_slab = 64 );
+  ~PacketPool();
+
+  /* take a buffer, adding a slab if none is free */
+  Buffer get();
+
+  size_t buffer_size() const { return buffer_size_; }
+  size_t capacity() const { return slabs_.size() * buffers_per_slab_; }
+  size_t available() const { return free_.size(); }
+
+  /* forbid copying or assigning */
+  PacketPool( const PacketPool & other ) = delete;
+  PacketPool & operator=( const PacketPool & other ) = delete;
+
+private:
+  size_t buffer_size_;
+  size_t buffers_per_slab_;
+  std::vector<char *> slabs_;
+  std::vector<char *> free_; /* a stack, so the most recently used buffer (likely cached) goes out first */
+
+  void grow();
+};
+
+#endif /* PACKET_POOL_HH */
@@ -1,69 +1,322 @@
 #include <algorithm>
-#include <cassert>
-#include <numeric>
 
+#include "config.h"
 #include "poller.hh"
+#include "io_uring.hh"
 #include "util.hh"
 
 using namespace std;
 using namespace PollerShortNames;
 
+Poller::Poller()
+  : epoll_( SystemCall( "epoll_create1", epoll_create1( EPOLL_CLOEXEC ) ) ),
+    actions_(),
+    armed_(),
+    registrations_(),
+    registration_by_fd_(),
+    free_actions_(),
+    free_registrations_(),
+    removed_(),
+    conditional_(),
+    dirty_(),
+    interested_count_( 0 ),
+    events_(),
+    rings_()
+{}
+
 void Poller::add_action( Poller::Action action )
 {
-  actions_.push_back( action );
-  pollfds_.push_back( { action.fd.fd_num(), 0, 0 } );
+  const int fd = action.fd.fd_num();
+
+  auto found = registration_by_fd_.find( fd );
+  if ( found == registration_by_fd_.end() ) {
+    if ( free_registrations_.empty() ) {
+      found = registration_by_fd_.emplace( fd, registrations_.size() ).first;
+      registrations_.push_back( { fd, 0, false, false, false, {} } );
+      events_.resize( registrations_.size() );
+    } else {
+      found = registration_by_fd_.emplace( fd, free_registrations_.back() ).first;
+      free_registrations_.pop_back();
+      registrations_.at( found->second ) = { fd, 0, false, false, false, {} };
+    }
+  }
+
+  const size_t registration_index = found->second;
+  Registration & registration = registrations_.at( registration_index );
+
+  /* interest in this fd must be recomputed before every wait */
+  if ( action.when_interested and action.check_every_wait
+       and find( conditional_.begin(), conditional_.end(), registration_index ) == conditional_.end() ) {
+    conditional_.push_back( registration_index );
+  }
+
+  if ( free_actions_.empty() ) {
+    registration.actions.push_back( actions_.size() );
+    actions_.emplace_back( new Action( action ) );
+    armed_.push_back( false );
+  } else {
+    registration.actions.push_back( free_actions_.back() );
+    free_actions_.pop_back();
+    actions_.at( registration.actions.back() ).reset( new Action( action ) );
+  }
+
+  mark_dirty( registration_index );
+}
+
+void Poller::remove_actions( const FileDescriptor & fd )
+{
+  const auto found = registration_by_fd_.find( fd.fd_num() );
+  if ( found == registration_by_fd_.end() ) {
+    return;
+  }
+
+  const size_t registration_index = found->second;
+  Registration & registration = registrations_.at( registration_index );
+  registration_by_fd_.erase( found );
+
+  if ( registration.added ) {
+    SystemCall( "epoll_ctl", epoll_ctl( epoll_.fd_num(), EPOLL_CTL_DEL, registration.fd, nullptr ) );
+    if ( registration.events ) {
+      interested_count_--;
+    }
+  }
+
+  for ( const auto & index : registration.actions ) {
+    actions_.at( index )->active = false;
+    armed_.at( index ) = false;
+  }
+
+  conditional_.erase( remove( conditional_.begin(), conditional_.end(), registration_index ),
+		      conditional_.end() );
+
+  registration.removed = true;
+  removed_.push_back( registration_index );
+}
+
+void Poller::refresh( const FileDescriptor & fd )
+{
+  const auto found = registration_by_fd_.find( fd.fd_num() );
+  if ( found != registration_by_fd_.end() ) {
+    mark_dirty( found->second );
+  }
+}
+
+/* recycle what remove_actions() left, once no callback can be running */
+void Poller::free_removed()
+{
+  for ( const auto & registration_index : removed_ ) {
+    Registration & registration = registrations_.at( registration_index );
+    for ( const auto & index : registration.actions ) {
+      actions_.at( index ).reset();
+      free_actions_.push_back( index );
+    }
+    registration.actions.clear();
+    free_registrations_.push_back( registration_index );
+  }
+
+  removed_.clear();
+}
+
+void Poller::add_ring( IOUring & ring )
+{
+  add_action( Action( ring, Direction::In, [&ring] () {
+	ring.reap();
+	return ResultType::Continue;
+      } ) );
+
+  rings_.push_back( &ring );
+}
+
+void Poller::mark_dirty( const size_t registration_index )
+{
+  Registration & registration = registrations_.at( registration_index );
+  if ( not registration.dirty ) {
+    registration.dirty = true;
+    dirty_.push_back( registration_index );
+  }
 }
 
 unsigned int Poller::Action::service_count() const
 {
-  return direction == Direction::In ? fd.read_count() : fd.write_count();
+  return direction == Direction::Out ? fd.write_count() : fd.read_count();
+}
+
+bool Poller::Action::interested() const
+{
+  /* don't poll in on fds that have had EOF */
+  if ( direction == Direction::In and fd.eof() ) {
+    return false;
+  }
+
+  return active and ((not when_interested) or when_interested());
+}
+
+/* tell epoll whether we care about an fd, if that has changed */
+void Poller::update_interest( Registration & registration )
+{
+  uint32_t events = 0;
+  for ( const auto & index : registration.actions ) {
+    armed_.at( index ) = actions_.at( index )->interested();
+    if ( armed_.at( index ) ) {
+      events |= actions_.at( index )->direction;
+    }
+  }
+
+  registration.dirty = false;
+
+  if ( registration.added and events == registration.events ) {
+    return;
+  }
+
+  epoll_event event;
+  zero( event );
+  event.events = events;
+  event.data.u64 = &registration - &registrations_[ 0 ];
+
+  SystemCall( "epoll_ctl", epoll_ctl( epoll_.fd_num(),
+				      registration.added ? EPOLL_CTL_MOD : EPOLL_CTL_ADD,
+				      registration.fd, &event ) );
+  registration.added = true;
+
+  if ( (registration.events == 0) != (events == 0) ) {
+    if ( events ) {
+      interested_count_++;
+    } else {
+      interested_count_--;
+    }
+  }
+
+  registration.events = events;
+}
+
+/* is an action on this fd armed to handle errors? */
+bool Poller::handles_errors( const Registration & registration ) const
+{
+  for ( const auto & index : registration.actions ) {
+    if ( armed_.at( index ) and actions_.at( index )->direction == Direction::Err ) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/* wait for events, with a timeout in microseconds */
+static int wait_for_events( const int epoll_fd, epoll_event * const events, const int max_events,
+			    const int64_t timeout_us )
+{
+#ifdef HAVE_EPOLL_PWAIT2
+  /* kernels before 5.11 don't have epoll_pwait2 */
+  static bool have_epoll_pwait2 = true;
+
+  if ( have_epoll_pwait2 ) {
+    timespec timeout;
+    timeout.tv_sec = timeout_us / 1000000;
+    timeout.tv_nsec = (timeout_us % 1000000) * 1000;
+
+    const int ret = epoll_pwait2( epoll_fd, events, max_events,
+				  timeout_us < 0 ? nullptr : &timeout, nullptr );
+    if ( ret >= 0 or errno != ENOSYS ) {
+      return SystemCall( "epoll_pwait2", ret );
+    }
+
+    have_epoll_pwait2 = false;
+  }
+#endif
+
+  /* fall back to whole milliseconds, rounding up so we never wake early */
+  const int timeout_ms = timeout_us < 0 ? -1 : (timeout_us + 999) / 1000;
+  return SystemCall( "epoll_wait", epoll_wait( epoll_fd, events, max_events, timeout_ms ) );
 }
 
 Poller::Result Poller::poll( const int & timeout_ms )
 {
-  assert( pollfds_.size() == actions_.size() );
-
-  /* tell poll whether we care about each fd */
-  for ( unsigned int i = 0; i < actions_.size(); i++ ) {
-    assert( pollfds_.at( i ).fd == actions_.at( i ).fd.fd_num() );
-    pollfds_.at( i ).events = (actions_.at( i ).active and actions_.at( i ).when_interested())
-      ? actions_.at( i ).direction : 0;
-
-    /* don't poll in on fds that have had EOF */
-    if ( actions_.at( i ).direction == Direction::In
-	 and actions_.at( i ).fd.eof() ) {
-      pollfds_.at( i ).events = 0;
+  return poll_us( timeout_ms < 0 ? -1 : int64_t( timeout_ms ) * 1000 );
+}
+
+Poller::Result Poller::poll_us( const int64_t timeout_us )
+{
+  free_removed();
+
+  /* bring the kernel's interest set up to date; only fds whose
+     interest may have changed since the last wait are examined */
+  for ( const auto & index : conditional_ ) {
+    mark_dirty( index );
+  }
+
+  for ( const auto & index : dirty_ ) {
+    if ( not registrations_.at( index ).removed ) {
+      update_interest( registrations_.at( index ) );
     }
   }
+  dirty_.clear();
+
+  for ( auto & ring : rings_ ) {
+    ring->submit();
+  }
 
-  /* Quit if no member in pollfds_ has a non-zero direction */
-  if ( not accumulate( pollfds_.begin(), pollfds_.end(), false,
-		       [] ( bool acc, pollfd x ) { return acc or x.events; } ) ) {
+  /* Quit if no fd has a non-zero direction */
+  if ( interested_count_ == 0 ) {
     return Result::Type::Exit;
   }
 
+  int ready_count;
   try {
-    if ( 0 == SystemCall( "poll", ::poll( &pollfds_[ 0 ], pollfds_.size(), timeout_ms ) ) ) {
-      return Result::Type::Timeout;
-    }
+    ready_count = wait_for_events( epoll_.fd_num(), &events_[ 0 ], events_.size(), timeout_us );
   } catch ( unix_error const& e ) {
     if ( e.code().value() == EINTR ) {
       return Result::Type::Exit;
     }
+    throw;
+  }
+
+  if ( ready_count == 0 ) {
+    return Result::Type::Timeout;
   }
 
-  for ( unsigned int i = 0; i < pollfds_.size(); i++ ) {
-    if ( pollfds_[ i ].revents & (POLLERR | POLLHUP | POLLNVAL) ) {
+  for ( int i = 0; i < ready_count; i++ ) {
+    const size_t registration_index = events_[ i ].data.u64;
+
+    /* (an earlier callback may have removed this fd) */
+    if ( registrations_.at( registration_index ).removed ) {
+      continue;
+    }
+
+    /* an error or hangup is fatal unless some action is waiting for it */
+    if ( (events_[ i ].events & (EPOLLERR | EPOLLHUP))
+	 and not handles_errors( registrations_.at( registration_index ) ) ) {
       return Result::Type::Exit;
     }
 
-    if ( pollfds_[ i ].revents & pollfds_[ i ].events ) {
+    /* (a hangup wakes the action waiting for errors) */
+    const uint32_t revents = events_[ i ].events | ((events_[ i ].events & EPOLLHUP) ? uint32_t( EPOLLERR ) : 0);
+
+    /* callbacks can change what this fd is interested in */
+    mark_dirty( registration_index );
+
+    /* (callbacks may add actions, so look everything up by index) */
+    for ( size_t j = 0; j < registrations_.at( registration_index ).actions.size(); j++ ) {
+      const size_t index = registrations_.at( registration_index ).actions.at( j );
+
       /* we only want to call callback if revents includes
 	 the event we asked for */
-      const auto count_before = actions_.at( i ).service_count();
-      auto result = actions_.at( i ).callback();
+      if ( not (armed_.at( index ) and (revents & actions_.at( index )->direction)) ) {
+	continue;
+      }
+
+      Action & action = *actions_.at( index );
+      const auto count_before = action.service_count();
+      auto result = action.callback();
+
+      /* (a callback that removed its fd may have closed it, too) */
+      if ( registrations_.at( registration_index ).removed ) {
+	if ( result.result == ResultType::Exit ) {
+	  return Result( Result::Type::Exit, result.exit_status );
+	}
+	break;
+      }
 
-      if ( count_before == actions_.at( i ).service_count() ) {
+      if ( count_before == action.service_count() ) {
 	throw runtime_error( "Poller: busy wait detected: callback did not read/write fd" );
       }
 
@@ -71,7 +324,7 @@ Poller::Result Poller::poll( const int & timeout_ms )
       case ResultType::Exit:
 	return Result( Result::Type::Exit, result.exit_status );
       case ResultType::Cancel:
-	actions_.at( i ).active = false;
+	action.active = false;
       case ResultType::Continue:
 	break;
       }
@@ -2,12 +2,17 @@
 #define POLLER_HH
 
 #include <functional>
+#include <memory>
 #include <vector>
+#include <cstdint>
+#include <unordered_map>
 
-#include <poll.h>
+#include <sys/epoll.h>
 
 #include "file_descriptor.hh"
 
+class IOUring;
+
 class Poller
 {
 public:
@@ -24,24 +29,74 @@ public:
     typedef std::function<Result(void)> CallbackType;
 
     FileDescriptor & fd;
-    enum PollDirection : short { In = POLLIN, Out = POLLOUT } direction;
+    /* (Err waits for a pending error, such as a socket's error queue, or a hangup) */
+    enum PollDirection : short { In = EPOLLIN, Out = EPOLLOUT, Err = EPOLLERR } direction;
     CallbackType callback;
-    std::function<bool(void)> when_interested;
+    std::function<bool(void)> when_interested; /* empty means always */
+
+    /* Is when_interested asked before every wait? If not, only after a
+       callback on the same fd has run, or the fd is refresh()ed: cheaper
+       with many fds, for interest that only those change. */
+    bool check_every_wait;
     bool active;
 
     Action( FileDescriptor & s_fd,
 	    const PollDirection & s_direction,
 	    const CallbackType & s_callback,
-	    const std::function<bool(void)> & s_when_interested = [] () { return true; } )
+	    const std::function<bool(void)> & s_when_interested = std::function<bool(void)>(),
+	    const bool s_check_every_wait = true )
       : fd( s_fd ), direction( s_direction ), callback( s_callback ),
-	when_interested( s_when_interested ), active( true ) {}
+	when_interested( s_when_interested ), check_every_wait( s_check_every_wait ),
+	active( true ) {}
 
     unsigned int service_count() const;
+
+    /* should the poller wait on this action right now? */
+    bool interested() const;
   };
 
 private:
-  std::vector< Action > actions_;
-  std::vector< pollfd > pollfds_;
+  /* Each fd is registered with epoll once, with the union of
+     the directions its actions are interested in. */
+  struct Registration
+  {
+    int fd;
+    uint32_t events; /* interest currently registered with the kernel */
+    bool added; /* has the fd been added to the epoll set yet? */
+    bool dirty; /* must interest be recomputed before the next wait? */
+    bool removed; /* see remove_actions() */
+    std::vector<size_t> actions; /* indices into actions_, in order added */
+  };
+
+  FileDescriptor epoll_;
+  /* (each action on the heap, so callbacks can add actions while running) */
+  std::vector< std::unique_ptr< Action > > actions_;
+  std::vector< bool > armed_; /* was each action part of the last wait? */
+  std::vector< Registration > registrations_;
+  std::unordered_map< int, size_t > registration_by_fd_;
+
+  /* slots to reuse, and registrations removed but not yet freed
+     (their actions may be running) */
+  std::vector< size_t > free_actions_, free_registrations_, removed_;
+
+  /* registrations with an action whose interest can change at any time */
+  std::vector< size_t > conditional_;
+
+  /* registrations whose interest must be recomputed before the next wait */
+  std::vector< size_t > dirty_;
+
+  /* how many registrations have nonzero interest */
+  size_t interested_count_;
+
+  std::vector< epoll_event > events_;
+
+  /* io_uring instances whose queued operations are submitted before each wait */
+  std::vector< IOUring * > rings_;
+
+  void mark_dirty( const size_t registration_index );
+  void free_removed();
+  void update_interest( Registration & registration );
+  bool handles_errors( const Registration & registration ) const;
 
 public:
   struct Result
@@ -52,9 +107,25 @@ public:
       : result( s_result ), exit_status( s_status ) {}
   };
 
-  Poller() : actions_(), pollfds_() {}
+  Poller();
   void add_action( Action action );
+
+  /* stop polling fd and drop its actions (before closing it, so its
+     number can be reused). Safe to call from any callback, including
+     the fd's own; the actions are freed before the next wait. */
+  void remove_actions( const FileDescriptor & fd );
+
+  /* ask fd's actions whether they are interested before the next wait */
+  void refresh( const FileDescriptor & fd );
+
+  /* run an io_uring's completion handlers from this poller (the ring
+     is readable while completions wait), and submit whatever has been
+     queued on it before each wait */
+  void add_ring( IOUring & ring );
   Result poll( const int & timeout_ms );
+
+  /* same, with a timeout in microseconds (negative means wait forever) */
+  Result poll_us( const int64_t timeout_us );
 };
 
 namespace PollerShortNames {
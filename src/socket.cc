@@ -1,4 +1,11 @@
 #include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+
+#include <algorithm>
+#include <cstring>
 
 #include "socket.hh"
 #include "util.hh"
@@ -75,39 +82,104 @@ void Socket::connect( const Address & address )
 				    address.size() ) );
 }
 
-/* receive datagram and where it came from */
-UDPSocket::received_datagram UDPSocket::recv()
+/* connect without waiting */
+Expected<bool> Socket::try_connect( const Address & address )
 {
-  static const ssize_t RECEIVE_MTU = 65536;
+  if ( ::connect( fd_num(), &address.to_sockaddr(), address.size() ) == 0 ) {
+    return Expected<bool>( true );
+  }
 
-  /* receive source address, timestamp and payload */
-  Address::raw datagram_source_address;
-  msghdr header; zero( header );
-  iovec msg_iovec; zero( msg_iovec );
+  if ( errno == EINPROGRESS ) {
+    return Expected<bool>( false );
+  }
+
+  return Expected<bool>::failure( "connect", errno );
+}
+
+int Socket::socket_error()
+{
+  int error;
+  socklen_t len = sizeof( error );
+  SystemCall( "getsockopt", getsockopt( fd_num(), SOL_SOCKET, SO_ERROR, &error, &len ) );
+  return error;
+}
+
+/* largest datagram we expect to receive */
+static const size_t RECEIVE_MTU = 65536;
+
+/* room for the ancillary data (timestamps) that accompany a datagram */
+static const size_t RECEIVE_CONTROL = 256;
 
-  char msg_payload[ RECEIVE_MTU ];
-  char msg_control[ RECEIVE_MTU ];
+/* each of recv_batch()'s buffers, without receive offload: a datagram
+   that fits a 1500-byte Ethernet MTU, with room to spare */
+static const size_t RECEIVE_SLOT = 2048;
+
+/* receive buffers of at least size bytes, allocated on first use. (One
+   per thread, shared by its sockets: everything received is copied out
+   before the call returns, and BATCH_SIZE of them are too big for the stack.) */
+static char * receive_buffer( const size_t size )
+{
+  static thread_local vector<char> buffer;
+  if ( buffer.size() < size ) {
+    buffer.resize( size );
+  }
+  return buffer.data();
+}
+
+/* point a msghdr at buffers for the source address, payload and ancillary data */
+static void prepare_receive( msghdr & header, iovec & msg_iovec,
+			     Address::raw & datagram_source_address,
+			     char * const payload, char * const control,
+			     const size_t payload_size = RECEIVE_MTU )
+{
+  zero( header );
+  zero( msg_iovec );
 
   /* prepare to get the source address */
   header.msg_name = &datagram_source_address;
   header.msg_namelen = sizeof( datagram_source_address );
 
   /* prepare to get the payload */
-  msg_iovec.iov_base = msg_payload;
-  msg_iovec.iov_len = sizeof( msg_payload );
+  msg_iovec.iov_base = payload;
+  msg_iovec.iov_len = payload_size;
   header.msg_iov = &msg_iovec;
   header.msg_iovlen = 1;
 
   /* prepare to get the timestamp */
-  header.msg_control = msg_control;
-  header.msg_controllen = sizeof( msg_control );
+  header.msg_control = control;
+  header.msg_controllen = RECEIVE_CONTROL;
+}
 
-  /* call recvmsg */
-  ssize_t recv_len = SystemCall( "recvmsg",
-				 recvmsg( fd_num(), &header, 0 ) );
+/* how large each datagram in a coalesced buffer is (0 if not coalesced) */
+static size_t received_segment_size( msghdr & header )
+{
+#ifdef UDP_GRO
+  cmsghdr *cmsg = CMSG_FIRSTHDR( &header );
+  while ( cmsg ) {
+    if ( cmsg->cmsg_level == SOL_UDP and cmsg->cmsg_type == UDP_GRO ) {
+      int segment_size;
+      memcpy( &segment_size, CMSG_DATA( cmsg ), sizeof( segment_size ) );
+      return segment_size;
+    }
+    cmsg = CMSG_NXTHDR( &header, cmsg );
+  }
+#else
+  (void) header;
+#endif
 
-  register_read();
+  return 0;
+}
 
+/* how far apart the datagrams in a received buffer of length bytes start */
+static size_t segment_step( msghdr & header, const size_t length )
+{
+  const size_t segment_size = received_segment_size( header );
+  return segment_size ? segment_size : max( length, size_t( 1 ) );
+}
+
+/* check the flags on a received datagram and find its timestamp (if there is one) */
+static uint64_t received_timestamp( msghdr & header )
+{
   /* make sure we got the whole datagram */
   if ( header.msg_flags & MSG_TRUNC ) {
     throw runtime_error( "recvfrom (oversized datagram)" );
@@ -123,11 +195,36 @@ UDPSocket::received_datagram UDPSocket::recv()
     if ( ts_hdr->cmsg_level == SOL_SOCKET
 	 and ts_hdr->cmsg_type == SO_TIMESTAMPNS ) {
       const timespec * const kernel_time = reinterpret_cast<timespec *>( CMSG_DATA( ts_hdr ) );
-      timestamp = timestamp_ms( *kernel_time );
+      timestamp = timestamp_us( *kernel_time );
     }
     ts_hdr = CMSG_NXTHDR( &header, ts_hdr );
   }
 
+  return timestamp;
+}
+
+/* receive datagram and where it came from */
+UDPSocket::received_datagram UDPSocket::recv()
+{
+  /* receive source address, timestamp and payload */
+  Address::raw datagram_source_address;
+  msghdr header;
+  iovec msg_iovec;
+
+  char * const msg_payload = receive_buffer( RECEIVE_MTU + RECEIVE_CONTROL );
+  char * const msg_control = msg_payload + RECEIVE_MTU;
+
+  prepare_receive( header, msg_iovec, datagram_source_address,
+		   msg_payload, msg_control );
+
+  /* call recvmsg */
+  ssize_t recv_len = SystemCall( "recvmsg",
+				 recvmsg( fd_num(), &header, 0 ) );
+
+  register_read();
+
+  const uint64_t timestamp = received_timestamp( header );
+
   received_datagram ret = { Address( datagram_source_address,
 				     header.msg_namelen ),
 			    timestamp,
@@ -136,20 +233,237 @@ UDPSocket::received_datagram UDPSocket::recv()
   return ret;
 }
 
+const size_t UDPSocket::received_packet::PAYLOAD_OFFSET;
+
+Address UDPSocket::received_packet::source_address() const
+{
+  return Address( *reinterpret_cast<const Address::raw *>( buffer.data() ), address_size );
+}
+
+/* point a msghdr at a pooled packet's buffer */
+static void prepare_packet( UDPSocket::received_packet & packet, msghdr & header, iovec & msg_iovec,
+			    char * const control )
+{
+  if ( packet.buffer.capacity() <= UDPSocket::received_packet::PAYLOAD_OFFSET ) {
+    throw runtime_error( "UDPSocket::recv( PacketPool & ): pool buffers too small" );
+  }
+
+  prepare_receive( header, msg_iovec, *reinterpret_cast<Address::raw *>( packet.buffer.data() ),
+		   packet.payload(), control,
+		   packet.buffer.capacity() - UDPSocket::received_packet::PAYLOAD_OFFSET );
+}
+
+/* receive a datagram into a pooled buffer */
+UDPSocket::received_packet UDPSocket::recv( PacketPool & pool )
+{
+  if ( gro_ ) {
+    throw runtime_error( "UDPSocket::recv( PacketPool & ) cannot split coalesced buffers" );
+  }
+
+  received_packet ret = { pool.get(), 0, 0, uint64_t( -1 ) };
+
+  msghdr header;
+  iovec msg_iovec;
+  char msg_control[ RECEIVE_CONTROL ];
+  prepare_packet( ret, header, msg_iovec, msg_control );
+
+  ret.length = SystemCall( "recvmsg", recvmsg( fd_num(), &header, 0 ) );
+
+  register_read();
+
+  ret.timestamp = received_timestamp( header );
+  ret.address_size = header.msg_namelen;
+
+  return ret;
+}
+
+/* receive into a pooled buffer, without waiting or throwing */
+Expected<UDPSocket::received_packet> UDPSocket::try_recv( PacketPool & pool )
+{
+  /* (a coalesced buffer can't be split into one packet) */
+  if ( gro_ ) {
+    return Expected<received_packet>::failure( "recvmsg", EINVAL );
+  }
+
+  received_packet ret = { pool.get(), 0, 0, uint64_t( -1 ) };
+
+  msghdr header;
+  iovec msg_iovec;
+  char msg_control[ RECEIVE_CONTROL ];
+  prepare_packet( ret, header, msg_iovec, msg_control );
+
+  const ssize_t recv_len = recvmsg( fd_num(), &header, MSG_DONTWAIT );
+
+  register_read();
+
+  if ( recv_len < 0 ) {
+    return Expected<received_packet>::failure( "recvmsg", errno );
+  }
+
+  if ( header.msg_flags & MSG_TRUNC ) {
+    return Expected<received_packet>::failure( "recvmsg", EMSGSIZE );
+  }
+
+  ret.length = recv_len;
+  ret.timestamp = received_timestamp( header );
+  ret.address_size = header.msg_namelen;
+
+  return Expected<received_packet>( move( ret ) );
+}
+
+/* receive a batch of datagrams, viewed in place */
+size_t UDPSocket::recv_batch( vector<received_view> & views )
+{
+  /* where each buffer came from (kept with the buffers, for the views to point to) */
+  static thread_local Address sources[ BATCH_SIZE ];
+
+  /* only a coalesced buffer needs room for a full-size datagram */
+  const size_t slot = gro_ ? RECEIVE_MTU : RECEIVE_SLOT;
+  char * const buffer = receive_buffer( BATCH_SIZE * (slot + RECEIVE_CONTROL) );
+
+  Address::raw source_addresses[ BATCH_SIZE ];
+  mmsghdr headers[ BATCH_SIZE ];
+  iovec msg_iovecs[ BATCH_SIZE ];
+
+  for ( unsigned int i = 0; i < BATCH_SIZE; i++ ) {
+    char * const payload = buffer + i * slot;
+    char * const control = buffer + BATCH_SIZE * slot + i * RECEIVE_CONTROL;
+    prepare_receive( headers[ i ].msg_hdr, msg_iovecs[ i ], source_addresses[ i ],
+		     payload, control, slot );
+    headers[ i ].msg_len = 0;
+  }
+
+  /* block for the first datagram, then take whatever else is already queued */
+  const size_t count = SystemCall( "recvmmsg",
+				   ::recvmmsg( fd_num(), headers, BATCH_SIZE,
+					       MSG_WAITFORONE, nullptr ) );
+
+  register_read();
+
+  size_t view_count = 0;
+  for ( size_t i = 0; i < count; i++ ) {
+    msghdr & header = headers[ i ].msg_hdr;
+
+    /* (the rest of the batch is already dequeued, so don't throw) */
+    if ( header.msg_flags & MSG_TRUNC ) {
+      truncated_count_++;
+      continue;
+    }
+
+    sources[ i ] = Address( source_addresses[ i ], header.msg_namelen );
+    const uint64_t timestamp = received_timestamp( header );
+
+    /* split a coalesced buffer back into its datagrams (the last may be short) */
+    char * const payload = buffer + i * slot;
+    const size_t length = headers[ i ].msg_len;
+    const size_t step = segment_step( header, length );
+
+    for ( size_t offset = 0; offset < length or offset == 0; offset += step ) {
+      if ( views.size() <= view_count ) {
+	views.resize( view_count + 1 );
+      }
+      views[ view_count++ ] = { &sources[ i ], timestamp, payload + offset, min( step, length - offset ) };
+    }
+  }
+
+  return view_count;
+}
+
+/* receive a batch of datagrams */
+size_t UDPSocket::recv_batch( vector<received_datagram> & datagrams )
+{
+  static thread_local vector<received_view> views;
+  const size_t count = recv_batch( views );
+
+  for ( size_t i = 0; i < count; i++ ) {
+    if ( datagrams.size() <= i ) {
+      datagrams.resize( i + 1, { Address(), uint64_t( -1 ), string() } );
+    }
+
+    datagrams[ i ].source_address = *views[ i ].source_address;
+    datagrams[ i ].timestamp = views[ i ].timestamp;
+    datagrams[ i ].payload.assign( views[ i ].payload, views[ i ].length );
+  }
+
+  return count;
+}
+
+/* unpack one received buffer into datagrams */
+size_t UDPSocket::unpack_received( msghdr & header, const char * const payload, const size_t length,
+				   vector<received_datagram> & datagrams, size_t datagram_count )
+{
+  const uint64_t timestamp = received_timestamp( header );
+  const Address source_address( *static_cast<const sockaddr *>( header.msg_name ), header.msg_namelen );
+
+  /* split a coalesced buffer back into its datagrams (the last may be short) */
+  const size_t step = segment_step( header, length );
+
+  for ( size_t offset = 0; offset < length or offset == 0; offset += step ) {
+    if ( datagrams.size() <= datagram_count ) {
+      datagrams.resize( datagram_count + 1, { Address(), uint64_t( -1 ), string() } );
+    }
+
+    received_datagram & datagram = datagrams[ datagram_count++ ];
+    datagram.timestamp = timestamp;
+    datagram.source_address = source_address;
+    datagram.payload.assign( payload + offset, min( step, length - offset ) );
+  }
+
+  return datagram_count;
+}
+
+/* account for a send that never waits */
+Expected<size_t> UDPSocket::finish_try_send( const char * const attempt, const ssize_t bytes_sent,
+					     const size_t length )
+{
+  register_write();
+
+  if ( bytes_sent < 0 ) {
+    return Expected<size_t>::failure( attempt, errno );
+  }
+
+  count_send( 1 );
+
+  if ( size_t( bytes_sent ) != length ) {
+    return Expected<size_t>::failure( attempt, EMSGSIZE );
+  }
+
+  return Expected<size_t>( size_t( bytes_sent ) );
+}
+
+Expected<size_t> UDPSocket::try_send( const char * const payload, const size_t length )
+{
+  return finish_try_send( "send", ::send( fd_num(), payload, length, MSG_DONTWAIT ), length );
+}
+
+Expected<size_t> UDPSocket::try_sendto( const Address & destination, const char * const payload,
+					const size_t length )
+{
+  return finish_try_send( "sendto", ::sendto( fd_num(), payload, length, MSG_DONTWAIT,
+					      &destination.to_sockaddr(), destination.size() ),
+			  length );
+}
+
 /* send datagram to specified address */
 void UDPSocket::sendto( const Address & destination, const string & payload )
+{
+  sendto( destination, payload.data(), payload.size() );
+}
+
+void UDPSocket::sendto( const Address & destination, const char * const payload, const size_t length )
 {
   const ssize_t bytes_sent =
     SystemCall( "sendto", ::sendto( fd_num(),
-				    payload.data(),
-				    payload.size(),
+				    payload,
+				    length,
 				    0,
 				    &destination.to_sockaddr(),
 				    destination.size() ) );
 
   register_write();
+  count_send( 1 );
 
-  if ( size_t( bytes_sent ) != payload.size() ) {
+  if ( size_t( bytes_sent ) != length ) {
     throw runtime_error( "datagram payload too big for sendto()" );
   }
 }
@@ -164,12 +478,158 @@ void UDPSocket::send( const string & payload )
 				0 ) );
 
   register_write();
+  count_send( 1 );
 
   if ( size_t( bytes_sent ) != payload.size() ) {
     throw runtime_error( "datagram payload too big for send()" );
   }
 }
 
+/* send several datagrams to connected address */
+void UDPSocket::send_batch( const vector<string>::const_iterator & begin,
+			    const vector<string>::const_iterator & end )
+{
+  mmsghdr headers[ BATCH_SIZE ];
+  iovec msg_iovecs[ BATCH_SIZE ];
+
+  auto it = begin;
+  while ( it != end ) {
+    /* fill in one sendmmsg() worth of datagrams */
+    unsigned int count = 0;
+    for ( ; count < BATCH_SIZE and it + count != end; count++ ) {
+      const string & payload = *(it + count);
+      zero( headers[ count ] );
+      msg_iovecs[ count ].iov_base = const_cast<char *>( payload.data() );
+      msg_iovecs[ count ].iov_len = payload.size();
+      headers[ count ].msg_hdr.msg_iov = &msg_iovecs[ count ];
+      headers[ count ].msg_hdr.msg_iovlen = 1;
+    }
+
+    send_messages( headers, count );
+    it += count;
+  }
+}
+
+/* send messages with sendmmsg(), until every one is out */
+void UDPSocket::send_messages( mmsghdr * const headers, const unsigned int count )
+{
+  /* the kernel may stop early, so keep going until the whole batch is out */
+  unsigned int sent = 0;
+  while ( sent < count ) {
+    sent += SystemCall( "sendmmsg", ::sendmmsg( fd_num(), headers + sent, count - sent, 0 ) );
+  }
+
+  register_write();
+
+  for ( unsigned int i = 0; i < count; i++ ) {
+    count_send( 1 );
+    if ( headers[ i ].msg_len != headers[ i ].msg_hdr.msg_iov->iov_len ) {
+      throw runtime_error( "datagram payload too big for sendmmsg()" );
+    }
+  }
+}
+
+/* most segments the kernel accepts in one segmented send */
+static const size_t MAX_SEGMENTS = 64;
+
+/* most bytes in one segmented send (a little under the 64 KiB IP limit) */
+static const size_t MAX_SEGMENTED_BYTES = 65000;
+
+/* send datagrams laid out back to back in one buffer */
+void UDPSocket::send_segments( const char * const data, const size_t segment_size, const size_t count )
+{
+  size_t done = 0;
+
+#ifdef UDP_SEGMENT
+  const size_t per_send = min( MAX_SEGMENTS, MAX_SEGMENTED_BYTES / segment_size );
+
+  while ( gso_ and per_send > 1 and count - done > 1 ) {
+    const size_t segments = min( per_send, count - done );
+
+    msghdr header;
+    iovec msg_iovec;
+    zero( header );
+    msg_iovec.iov_base = const_cast<char *>( data + done * segment_size );
+    msg_iovec.iov_len = segments * segment_size;
+    header.msg_iov = &msg_iovec;
+    header.msg_iovlen = 1;
+
+    /* tell the kernel where to cut the buffer into datagrams */
+    char control[ CMSG_SPACE( sizeof( uint16_t ) ) ];
+    zero( control );
+    header.msg_control = control;
+    header.msg_controllen = sizeof( control );
+    cmsghdr * const cmsg = CMSG_FIRSTHDR( &header );
+    cmsg->cmsg_level = SOL_UDP;
+    cmsg->cmsg_type = UDP_SEGMENT;
+    cmsg->cmsg_len = CMSG_LEN( sizeof( uint16_t ) );
+    const uint16_t gso_size = segment_size;
+    memcpy( CMSG_DATA( cmsg ), &gso_size, sizeof( gso_size ) );
+
+    const ssize_t bytes_sent = SystemCall( "sendmsg", ::sendmsg( fd_num(), &header, 0 ) );
+
+    register_write();
+    count_send( segments );
+
+    if ( size_t( bytes_sent ) != msg_iovec.iov_len ) {
+      throw runtime_error( "segmented payload too big for sendmsg()" );
+    }
+
+    done += segments;
+  }
+#endif
+
+  /* whatever is left goes out one message per datagram */
+  mmsghdr headers[ BATCH_SIZE ];
+  iovec msg_iovecs[ BATCH_SIZE ];
+
+  while ( done < count ) {
+    const unsigned int batch = min( count - done, size_t( BATCH_SIZE ) );
+    for ( unsigned int i = 0; i < batch; i++ ) {
+      zero( headers[ i ] );
+      msg_iovecs[ i ].iov_base = const_cast<char *>( data + (done + i) * segment_size );
+      msg_iovecs[ i ].iov_len = segment_size;
+      headers[ i ].msg_hdr.msg_iov = &msg_iovecs[ i ];
+      headers[ i ].msg_hdr.msg_iovlen = 1;
+    }
+
+    send_messages( headers, batch );
+    done += batch;
+  }
+}
+
+/* turn on UDP segmentation offload, if the kernel has it */
+bool UDPSocket::set_gso()
+{
+#ifdef UDP_SEGMENT
+  /* (a default segment size of 0 only segments sends that ask, so this just probes) */
+  const int no_default_size = 0;
+  gso_ = ::setsockopt( fd_num(), SOL_UDP, UDP_SEGMENT, &no_default_size, sizeof( no_default_size ) ) == 0;
+#endif
+  return gso_;
+}
+
+/* turn on UDP receive offload, if the kernel has it */
+bool UDPSocket::set_gro()
+{
+#ifdef UDP_GRO
+  const int on = true;
+  gro_ = ::setsockopt( fd_num(), SOL_UDP, UDP_GRO, &on, sizeof( on ) ) == 0;
+#endif
+  return gro_;
+}
+
+/* account for one send call carrying datagram_count datagrams */
+void UDPSocket::count_send( const size_t datagram_count )
+{
+  if ( not tx_first_datagram_.empty() ) {
+    tx_first_datagram_[ tx_key_ % TX_HISTORY ] = datagrams_sent_;
+  }
+
+  tx_key_++;
+  datagrams_sent_ += datagram_count;
+}
+
 /* mark the socket as listening for incoming connections */
 void TCPSocket::listen( const int backlog )
 {
@@ -177,10 +637,46 @@ void TCPSocket::listen( const int backlog )
 }
 
 /* accept a new incoming connection */
-TCPSocket TCPSocket::accept()
+TCPSocket TCPSocket::accept( const bool blocking )
+{
+  register_read();
+  return TCPSocket( FileDescriptor( SystemCall( "accept", ::accept4( fd_num(), nullptr, nullptr,
+								   blocking ? 0 : SOCK_NONBLOCK ) ) ) );
+}
+
+/* accept without waiting or throwing */
+Expected<TCPSocket> TCPSocket::try_accept()
+{
+  register_read();
+
+  const int fd = ::accept4( fd_num(), nullptr, nullptr, SOCK_NONBLOCK );
+  if ( fd < 0 ) {
+    return Expected<TCPSocket>::failure( "accept", errno );
+  }
+
+  return Expected<TCPSocket>( TCPSocket( FileDescriptor( fd ) ) );
+}
+
+/* send without waiting, throwing, or raising SIGPIPE */
+Expected<size_t> TCPSocket::try_send( const char * const data, const size_t length )
+{
+  Expected<size_t> result = TrySystemCall( "send", ::send( fd_num(), data, length,
+							  MSG_DONTWAIT | MSG_NOSIGNAL ) );
+  register_write();
+  return result;
+}
+
+/* receive without waiting or throwing */
+Expected<size_t> TCPSocket::try_recv( char * const buffer, const size_t length )
 {
+  Expected<size_t> result = TrySystemCall( "recv", ::recv( fd_num(), buffer, length, MSG_DONTWAIT ) );
   register_read();
-  return TCPSocket( FileDescriptor( SystemCall( "accept", ::accept( fd_num(), nullptr, nullptr ) ) ) );
+
+  if ( result.ok() and result.value() == 0 and length > 0 ) {
+    set_eof();
+  }
+
+  return result;
 }
 
 /* set socket option */
@@ -197,8 +693,100 @@ void Socket::set_reuseaddr()
   setsockopt( SOL_SOCKET, SO_REUSEADDR, int( true ) );
 }
 
+/* let several sockets share a port, with the kernel spreading flows across them */
+void Socket::set_reuseport()
+{
+  setsockopt( SOL_SOCKET, SO_REUSEPORT, int( true ) );
+}
+
 /* turn on timestamps on receipt */
 void UDPSocket::set_timestamps()
 {
   setsockopt( SOL_SOCKET, SO_TIMESTAMPNS, int( true ) );
 }
+
+/* turn on kernel timestamps on transmit */
+void UDPSocket::set_tx_timestamps()
+{
+  /* number each datagram (OPT_ID) and don't echo its payload back (OPT_TSONLY) */
+  setsockopt( SOL_SOCKET, SO_TIMESTAMPING,
+	      int( SOF_TIMESTAMPING_TX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE
+		   | SOF_TIMESTAMPING_OPT_ID | SOF_TIMESTAMPING_OPT_TSONLY ) );
+
+  /* the kernel starts numbering send calls afresh */
+  tx_key_ = 0;
+  datagrams_sent_ = 0;
+  tx_first_datagram_.assign( TX_HISTORY, 0 );
+}
+
+/* collect transmit timestamps from the error queue */
+size_t UDPSocket::recv_tx_timestamps( vector<tx_timestamp> & timestamps )
+{
+  size_t count = 0;
+
+  register_read();
+
+  while ( true ) {
+    msghdr header;
+    zero( header );
+    char control[ RECEIVE_CONTROL ];
+    header.msg_control = control;
+    header.msg_controllen = sizeof( control );
+
+    if ( recvmsg( fd_num(), &header, MSG_ERRQUEUE | MSG_DONTWAIT ) < 0 ) {
+      if ( errno != EAGAIN and errno != EWOULDBLOCK ) {
+	throw unix_error( "recvmsg (error queue)" );
+      }
+
+      /* Woken with nothing queued: a pending socket error (say, ECONNREFUSED
+	 from an ICMP port unreachable) keeps EPOLLERR raised, and reading
+	 the error queue doesn't clear it, so take it and report it */
+      if ( count == 0 ) {
+	const int error = socket_error();
+	if ( error ) {
+	  throw unix_error( "socket error", error );
+	}
+      }
+
+      return count;
+    }
+
+    /* each message carries a timestamp and the extended error that names its send call */
+    uint32_t key = 0;
+    uint64_t timestamp = -1;
+    bool have_key = false;
+
+    for ( cmsghdr *cmsg = CMSG_FIRSTHDR( &header ); cmsg; cmsg = CMSG_NXTHDR( &header, cmsg ) ) {
+      if ( cmsg->cmsg_level == SOL_SOCKET and cmsg->cmsg_type == SO_TIMESTAMPING ) {
+	const scm_timestamping * const kernel_time = reinterpret_cast<scm_timestamping *>( CMSG_DATA( cmsg ) );
+	timestamp = timestamp_us( kernel_time->ts[ 0 ] );
+      } else if ( (cmsg->cmsg_level == SOL_IP and cmsg->cmsg_type == IP_RECVERR)
+		  or (cmsg->cmsg_level == SOL_IPV6 and cmsg->cmsg_type == IPV6_RECVERR) ) {
+	const sock_extended_err * const error = reinterpret_cast<sock_extended_err *>( CMSG_DATA( cmsg ) );
+	if ( error->ee_errno == ENOMSG and error->ee_origin == SO_EE_ORIGIN_TIMESTAMPING ) {
+	  key = error->ee_data;
+	  have_key = true;
+	}
+      }
+    }
+
+    /* skip anything else that lands on the error queue, and
+       send calls too old to remember */
+    if ( not have_key or timestamp == uint64_t( -1 )
+	 or tx_first_datagram_.empty() or uint32_t( tx_key_ - key ) > TX_HISTORY ) {
+      continue;
+    }
+
+    const uint64_t first = tx_first_datagram_[ key % TX_HISTORY ];
+    const uint64_t end = uint32_t( key + 1 ) == tx_key_
+      ? datagrams_sent_ : tx_first_datagram_[ (key + 1) % TX_HISTORY ];
+    const tx_timestamp entry = { first, size_t( end - first ), timestamp };
+
+    if ( timestamps.size() <= count ) {
+      timestamps.resize( count + 1, entry );
+    } else {
+      timestamps[ count ] = entry;
+    }
+    count++;
+  }
+}
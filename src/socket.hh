@@ -2,9 +2,14 @@
 #define SOCKET_HH
 
 #include <functional>
+#include <string>
+#include <vector>
+
+#include <sys/socket.h>
 
 #include "address.hh"
 #include "file_descriptor.hh"
+#include "packet_pool.hh"
 
 /* class for network sockets (UDP, TCP, etc.) */
 class Socket : public FileDescriptor
@@ -32,37 +37,190 @@ public:
   /* connect socket to a specified peer address */
   void connect( const Address & address );
 
+  /* start connecting without waiting (on a nonblocking socket): true if
+     connected already, false if under way, in which case the socket turns
+     writable once it is done, and socket_error() says how it went */
+  Expected<bool> try_connect( const Address & address );
+
+  /* take the socket's pending error (0 if none), such as the outcome of a
+     nonblocking connect */
+  int socket_error();
+
   /* accessors */
   Address local_address() const;
   Address peer_address() const;
 
   /* allow local address to be reused sooner, at the cost of some robustness */
   void set_reuseaddr();
+
+  /* let several sockets bind the same address and port,
+     with the kernel spreading incoming flows across them */
+  void set_reuseport();
 };
 
 /* UDP socket */
 class UDPSocket : public Socket
 {
+private:
+  /* are segmentation offload (send) and receive offload turned on? */
+  bool gso_;
+  bool gro_;
+
+  /* oversized datagrams that recv_batch() has dropped */
+  uint64_t truncated_count_;
+
+  /* The kernel numbers each send call (each message of a sendmmsg())
+     that it timestamps; a segmented send is one call but many datagrams.
+     Remember the first datagram of each recent call so a transmit
+     timestamp can be matched with the datagrams it covers. */
+  static const uint32_t TX_HISTORY = 4096;
+  uint32_t tx_key_; /* number of send calls so far */
+  uint64_t datagrams_sent_;
+  std::vector<uint64_t> tx_first_datagram_; /* by key modulo TX_HISTORY */
+
+  /* account for one send call carrying datagram_count datagrams */
+  void count_send( const size_t datagram_count );
+
+  /* account for a send from try_send() or try_sendto() */
+  Expected<size_t> finish_try_send( const char * const attempt, const ssize_t bytes_sent,
+				    const size_t length );
+
+  /* send messages with sendmmsg(), until every one is out */
+  void send_messages( mmsghdr * const headers, const unsigned int count );
+
 public:
-  UDPSocket() : Socket( AF_INET6, SOCK_DGRAM ) {}
+  UDPSocket()
+    : Socket( AF_INET6, SOCK_DGRAM ), gso_( false ), gro_( false ),
+      truncated_count_( 0 ), tx_key_( 0 ), datagrams_sent_( 0 ), tx_first_datagram_()
+  {}
 
   struct received_datagram {
     Address source_address;
-    uint64_t timestamp;
+    uint64_t timestamp; /* kernel receive time, in microseconds (see timestamp.hh) */
     std::string payload;
   };
 
   /* receive datagram, timestamp, and where it came from */
   received_datagram recv();
 
+  /* a datagram received into a pooled buffer, which holds the source
+     address and then the payload; the buffer goes back to its pool
+     when the packet is destroyed */
+  struct received_packet {
+    PacketPool::Buffer buffer;
+    socklen_t address_size;
+    size_t length;
+    uint64_t timestamp; /* kernel receive time, in microseconds (see timestamp.hh) */
+
+    /* where the payload starts in the buffer (past the address, on a cache line) */
+    static const size_t PAYLOAD_OFFSET = (sizeof( Address::raw ) + PacketPool::CACHE_LINE - 1)
+      / PacketPool::CACHE_LINE * PacketPool::CACHE_LINE;
+
+    const char * payload() const { return buffer.data() + PAYLOAD_OFFSET; }
+    char * payload() { return buffer.data() + PAYLOAD_OFFSET; }
+    Address source_address() const;
+  };
+
+  /* receive a datagram straight into a buffer from pool, without copying
+     it or allocating (once the pool is warm). Datagrams larger than
+     the buffer's room for payload are an error, as are buffers coalesced
+     by receive offload (so this refuses to run after set_gro()). */
+  received_packet recv( PacketPool & pool );
+
+  /* Counterparts of recv( PacketPool & ), send() and sendto() that never
+     wait, even on a blocking socket, and return failure (EAGAIN when
+     there is nothing to receive or no room to send) in the result instead
+     of throwing. A datagram too big for the buffer, or sent short, is
+     EMSGSIZE; try_recv() after set_gro() is EINVAL. */
+  Expected<received_packet> try_recv( PacketPool & pool );
+  Expected<size_t> try_send( const char * const payload, const size_t length );
+  Expected<size_t> try_sendto( const Address & destination,
+			       const char * const payload, const size_t length );
+
+  /* largest number of datagrams handed to the kernel in one batch syscall */
+  static const unsigned int BATCH_SIZE = 64;
+
+  /* receive up to BATCH_SIZE buffers (using recvmmsg), blocking only
+     until the first one arrives. Buffers the kernel coalesced (see
+     set_gro()) are split back into datagrams, which share a timestamp.
+     Fills the front of datagrams, reusing its existing elements, and
+     returns how many were received. Without receive offload, each buffer
+     holds 2048 bytes; a datagram too big for its buffer is dropped (and
+     counted, see truncated_count()), not the batch. */
+  size_t recv_batch( std::vector<received_datagram> & datagrams );
+
+  /* a datagram that recv_batch() left in place in the thread's receive
+     buffers, which it shares among its sockets: valid (and writable)
+     until the thread next receives on any UDPSocket */
+  struct received_view {
+    const Address * source_address; /* (shared by a coalesced buffer's datagrams) */
+    uint64_t timestamp; /* kernel receive time, in microseconds (see timestamp.hh) */
+    char * payload;
+    size_t length;
+  };
+
+  /* the same, without copying each datagram or its source address out */
+  size_t recv_batch( std::vector<received_view> & views );
+
+  /* how many oversized datagrams recv_batch() has dropped */
+  uint64_t truncated_count() const { return truncated_count_; }
+
+  /* unpack one received buffer, as recvmsg() described it in header (source
+     address and ancillary data), into datagrams[ datagram_count ] onward:
+     finds the timestamp and splits a coalesced buffer. Returns the new
+     count. (Shared with receive paths that bypass recv_batch(), such as
+     io_uring.hh's.) */
+  static size_t unpack_received( msghdr & header, const char * const payload, const size_t length,
+				 std::vector<received_datagram> & datagrams, size_t datagram_count );
+
   /* send datagram to specified address */
   void sendto( const Address & peer, const std::string & payload );
+  void sendto( const Address & peer, const char * const payload, const size_t length );
 
   /* send datagram to connected address */
   void send( const std::string & payload );
 
+  /* send several datagrams to connected address (using sendmmsg) */
+  void send_batch( const std::vector<std::string>::const_iterator & begin,
+		   const std::vector<std::string>::const_iterator & end );
+  void send_batch( const std::vector<std::string> & payloads )
+  {
+    send_batch( payloads.begin(), payloads.end() );
+  }
+
+  /* send count datagrams of segment_size bytes each, laid out back to back
+     in data, to connected address. With segmentation offload (see
+     set_gso()), each send call carries as many as the kernel allows;
+     otherwise they go out with sendmmsg. */
+  void send_segments( const char * const data, const size_t segment_size, const size_t count );
+
+  /* turn on UDP segmentation offload for send_segments();
+     returns false (and leaves it off) if the kernel lacks it */
+  bool set_gso();
+
+  /* turn on UDP receive offload, which lets the kernel hand recv_batch()
+     runs of datagrams from one source in a single buffer; returns false
+     (and leaves it off) if the kernel lacks it */
+  bool set_gro();
+
   /* turn on timestamps on receipt */
   void set_timestamps();
+
+  struct tx_timestamp {
+    uint64_t first_datagram; /* counting datagrams sent on this socket, from 0 */
+    size_t datagram_count; /* how many went out in the send call (from first_datagram on) */
+    uint64_t timestamp; /* kernel transmit time, in microseconds (see timestamp.hh) */
+  };
+
+  /* turn on kernel (software) timestamps on transmit, which are
+     queued on the socket's error queue (signalled by EPOLLERR) */
+  void set_tx_timestamps();
+
+  /* collect every transmit timestamp waiting on the error queue, without
+     blocking. Fills the front of timestamps and returns how many there were.
+     If there were none, throws any pending socket error (which would
+     otherwise keep the socket signalling EPOLLERR). */
+  size_t recv_tx_timestamps( std::vector<tx_timestamp> & timestamps );
 };
 
 /* TCP socket */
@@ -78,8 +236,18 @@ public:
   /* mark the socket as listening for incoming connections */
   void listen( const int backlog = 16 );
 
-  /* accept a new incoming connection */
-  TCPSocket accept();
+  /* accept a new incoming connection (nonblocking from the start, if asked) */
+  TCPSocket accept( const bool blocking = true );
+
+  /* accept a waiting connection (made nonblocking) without waiting,
+     on a nonblocking socket; EAGAIN if there is none */
+  Expected<TCPSocket> try_accept();
+
+  /* send or receive what can be without waiting, with failure in the
+     result: EAGAIN if nothing can be, and EPIPE (not SIGPIPE) once the
+     peer has gone. Receiving 0 bytes means EOF. */
+  Expected<size_t> try_send( const char * const data, const size_t length );
+  Expected<size_t> try_recv( char * const buffer, const size_t length );
 };
 
 #endif /* SOCKET_HH */
@@ -0,0 +1,171 @@
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+
+#include <sys/eventfd.h>
+
+#include "tcp_server.hh"
+#include "util.hh"
+
+using namespace std;
+using namespace PollerShortNames;
+
+TCPServer::Connection::Connection( TCPSocket && socket )
+  : socket_( move( socket ) ),
+    stream_( socket_ ),
+    closing_( false )
+{}
+
+/* add one to an eventfd's counter */
+static void signal_eventfd( FileDescriptor & fd )
+{
+  const uint64_t one = 1;
+  fd.write( string( reinterpret_cast<const char *>( &one ), sizeof( one ) ) );
+}
+
+TCPServer::EventLoop::EventLoop( const Handler & handler )
+  : handler_( handler ),
+    poller_(),
+    wakeup_( SystemCall( "eventfd", eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC ) ) ),
+    mutex_(),
+    incoming_(),
+    stopping_( false ),
+    connections_(),
+    thread_()
+{
+  poller_.add_action( Action( wakeup_, Direction::In, [&] () {
+	accept_incoming();
+	return ResultType::Continue;
+      } ) );
+
+  thread_ = thread( [&] () {
+      try {
+	loop();
+      } catch ( const exception & e ) {
+	print_exception( e );
+	exit( EXIT_FAILURE );
+      }
+    } );
+}
+
+TCPServer::EventLoop::~EventLoop()
+{
+  {
+    lock_guard<mutex> lock( mutex_ );
+    stopping_ = true;
+  }
+  signal_eventfd( wakeup_ );
+  thread_.join();
+}
+
+void TCPServer::EventLoop::hand_off( TCPSocket && socket )
+{
+  bool was_empty;
+  {
+    lock_guard<mutex> lock( mutex_ );
+    was_empty = incoming_.empty();
+    incoming_.push_back( move( socket ) );
+  }
+
+  /* (one wakeup covers everything queued before the loop gets to it) */
+  if ( was_empty ) {
+    signal_eventfd( wakeup_ );
+  }
+}
+
+void TCPServer::EventLoop::loop()
+{
+  while ( true ) {
+    poller_.poll( -1 );
+
+    lock_guard<mutex> lock( mutex_ );
+    if ( stopping_ ) {
+      return;
+    }
+  }
+}
+
+/* take the connections the acceptor has queued */
+void TCPServer::EventLoop::accept_incoming()
+{
+  char counter[ 8 ];
+  wakeup_.read_into( counter, sizeof( counter ) );
+
+  vector<TCPSocket> incoming;
+  {
+    lock_guard<mutex> lock( mutex_ );
+    incoming.swap( incoming_ );
+  }
+
+  for ( auto & socket : incoming ) {
+    add( move( socket ) );
+  }
+}
+
+void TCPServer::EventLoop::add( TCPSocket && socket )
+{
+  const int fd = socket.fd_num();
+  unique_ptr<Connection> & slot = connections_[ fd ];
+  slot.reset( new Connection( move( socket ) ) );
+  Connection & connection = *slot;
+
+  /* a reset or hangup (or a failed read or write) closes the
+     connection, and affects no one else */
+  connection.stream().add_actions( poller_, [this, &connection] ( ByteStream & stream ) {
+      try {
+	if ( stream.buffered() or stream.eof() ) {
+	  handler_( connection );
+	}
+      } catch ( const unix_error & ) {
+	drop( connection );
+	return;
+      }
+
+      if ( connection.finished() ) {
+	drop( connection );
+      }
+    }, [this, &connection] () { drop( connection ); } );
+}
+
+void TCPServer::EventLoop::drop( Connection & connection )
+{
+  const int fd = connection.socket().fd_num();
+  poller_.remove_actions( connection.socket() );
+  connections_.erase( fd ); /* (closes the socket) */
+}
+
+TCPServer::TCPServer( const Address & address, const Handler & handler, const unsigned int loop_count )
+  : listener_(),
+    handler_( handler ),
+    loops_()
+{
+  /* a peer that closes early should cost an EPIPE, not the process */
+  signal( SIGPIPE, SIG_IGN );
+
+  listener_.set_reuseaddr();
+  listener_.bind( address );
+  listener_.listen( 1024 );
+
+  const unsigned int count = loop_count ? loop_count : max( 1u, thread::hardware_concurrency() );
+  for ( unsigned int i = 0; i < count; i++ ) {
+    loops_.emplace_back( new EventLoop( handler_ ) );
+  }
+}
+
+void TCPServer::run()
+{
+  for ( size_t next = 0; true; next = (next + 1) % loops_.size() ) {
+    try {
+      TCPSocket socket = listener_.accept( false );
+      loops_.at( next )->hand_off( move( socket ) );
+    } catch ( const unix_error & e ) {
+      const int error = e.code().value();
+      if ( error == EMFILE or error == ENFILE ) {
+	/* out of file descriptors: wait for some connections to close */
+	this_thread::sleep_for( chrono::milliseconds( 10 ) );
+      } else if ( error != ECONNABORTED and error != EINTR ) {
+	throw;
+      }
+    }
+  }
+}
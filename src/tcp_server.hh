@@ -0,0 +1,96 @@
+#ifndef TCP_SERVER_HH
+#define TCP_SERVER_HH
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "byte_stream.hh"
+#include "poller.hh"
+#include "socket.hh"
+
+/* A TCP server that spreads many connections over a few threads: one
+   thread accepts, handing each connection round-robin to one of N event
+   loops, each a thread with its own Poller. Connections are nonblocking
+   and buffered (see byte_stream.hh); the handler is called on the
+   connection's loop whenever new input arrives (or the peer finishes),
+   and again after a flush while input waits. A connection is closed once
+   the peer has finished and everything queued has been written, once
+   the handler calls close() and everything is written, or at once on a
+   reset. */
+class TCPServer
+{
+public:
+  class Connection
+  {
+  private:
+    TCPSocket socket_;
+    ByteStream stream_;
+    bool closing_;
+
+  public:
+    Connection( TCPSocket && socket );
+
+    TCPSocket & socket() { return socket_; }
+    ByteStream & stream() { return stream_; }
+
+    /* close the connection once everything queued is written */
+    void close() { closing_ = true; }
+
+    /* is the connection ready to be closed? */
+    bool finished() const { return (closing_ or stream_.eof()) and stream_.queued() == 0; }
+  };
+
+  typedef std::function<void( Connection & )> Handler;
+
+private:
+  /* one thread's connections, and the queue of new ones handed to it */
+  class EventLoop
+  {
+  private:
+    const Handler & handler_;
+    Poller poller_;
+    FileDescriptor wakeup_; /* an eventfd the acceptor signals */
+    std::mutex mutex_;
+    std::vector<TCPSocket> incoming_;
+    bool stopping_;
+    std::unordered_map< int, std::unique_ptr<Connection> > connections_;
+    std::thread thread_;
+
+    void loop();
+    void accept_incoming();
+    void add( TCPSocket && socket );
+    void drop( Connection & connection );
+
+  public:
+    EventLoop( const Handler & handler );
+
+    /* stops the loop, closing its connections */
+    ~EventLoop();
+
+    /* give the loop a new connection (from any thread) */
+    void hand_off( TCPSocket && socket );
+
+    /* forbid copying or assigning */
+    EventLoop( const EventLoop & other ) = delete;
+    EventLoop & operator=( const EventLoop & other ) = delete;
+  };
+
+  TCPSocket listener_;
+  Handler handler_;
+  std::vector< std::unique_ptr<EventLoop> > loops_;
+
+public:
+  /* listen on address, with loop_count event loops (0: one per core) */
+  TCPServer( const Address & address, const Handler & handler, const unsigned int loop_count = 0 );
+
+  Address local_address() const { return listener_.local_address(); }
+
+  /* accept connections forever, on the calling thread */
+  void run();
+};
+
+#endif /* TCP_SERVER_HH */
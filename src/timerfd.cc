@@ -0,0 +1,54 @@
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include "timerfd.hh"
+#include "util.hh"
+
+using namespace std;
+
+TimerFD::TimerFD()
+  : FileDescriptor( SystemCall( "timerfd_create",
+				timerfd_create( CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC ) ) ),
+    armed_( false )
+{}
+
+/* fire once, delay_ns from now */
+void TimerFD::arm( const uint64_t delay_ns )
+{
+  itimerspec spec;
+  zero( spec );
+
+  /* an all-zero it_value would disarm the timer instead */
+  const uint64_t delay = max( delay_ns, uint64_t( 1 ) );
+  spec.it_value.tv_sec = delay / 1000000000;
+  spec.it_value.tv_nsec = delay % 1000000000;
+
+  SystemCall( "timerfd_settime", timerfd_settime( fd_num(), 0, &spec, nullptr ) );
+  armed_ = true;
+}
+
+/* cancel a pending expiration */
+void TimerFD::disarm()
+{
+  itimerspec spec;
+  zero( spec );
+
+  SystemCall( "timerfd_settime", timerfd_settime( fd_num(), 0, &spec, nullptr ) );
+  armed_ = false;
+}
+
+/* consume the expiration */
+uint64_t TimerFD::read_expirations()
+{
+  uint64_t expirations = 0;
+
+  const ssize_t bytes_read = ::read( fd_num(), &expirations, sizeof( expirations ) );
+  if ( bytes_read < 0 and errno != EAGAIN ) {
+    throw unix_error( "read (timerfd)" );
+  }
+
+  register_read();
+  armed_ = false;
+
+  return expirations;
+}
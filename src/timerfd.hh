@@ -0,0 +1,30 @@
+#ifndef TIMERFD_HH
+#define TIMERFD_HH
+
+#include <cstdint>
+
+#include "file_descriptor.hh"
+
+/* one-shot timer on the monotonic clock that can be polled like any other fd */
+class TimerFD : public FileDescriptor
+{
+private:
+  bool armed_;
+
+public:
+  TimerFD();
+
+  /* fire once, delay_ns from now */
+  void arm( const uint64_t delay_ns );
+
+  /* cancel a pending expiration */
+  void disarm();
+
+  /* is an expiration pending (or unread)? */
+  bool armed() const { return armed_; }
+
+  /* consume the expiration, returning how many times the timer fired */
+  uint64_t read_expirations();
+};
+
+#endif /* TIMERFD_HH */
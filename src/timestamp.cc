@@ -3,6 +3,9 @@
 #include "timestamp.hh"
 #include "util.hh"
 
+/* nanoseconds per microsecond */
+static const uint64_t THOUSAND = 1000;
+
 /* nanoseconds per millisecond */
 static const uint64_t MILLION = 1000000;
 
@@ -10,27 +13,63 @@ static const uint64_t MILLION = 1000000;
 static const uint64_t BILLION = 1000 * MILLION;
 
 /* helper functions */
-static timespec current_time()
+static timespec current_time( const clockid_t clock )
 {
   timespec ret;
-  SystemCall( "clock_gettime", clock_gettime( CLOCK_REALTIME, &ret ) );
+  SystemCall( "clock_gettime", clock_gettime( clock, &ret ) );
   return ret;
 }
 
-static uint64_t timestamp_ms_raw( const timespec & ts )
+static uint64_t timestamp_ns_raw( const timespec & ts )
+{
+  return ts.tv_sec * BILLION + ts.tv_nsec;
+}
+
+/* monotonic time when the program first asked for a timestamp */
+static uint64_t epoch()
+{
+  const static uint64_t EPOCH = timestamp_ns_raw( current_time( CLOCK_MONOTONIC ) );
+  return EPOCH;
+}
+
+/* Current time since the start of the program */
+uint64_t timestamp_ns()
+{
+  const uint64_t start = epoch();
+  return timestamp_ns_raw( current_time( CLOCK_MONOTONIC ) ) - start;
+}
+
+uint64_t timestamp_us()
 {
-  const uint64_t nanos = ts.tv_sec * BILLION + ts.tv_nsec;
-  return nanos / MILLION;
+  return timestamp_ns() / THOUSAND;
 }
 
-/* Current time in milliseconds since the start of the program */
 uint64_t timestamp_ms()
 {
-  return timestamp_ms( current_time() );
+  return timestamp_ns() / MILLION;
+}
+
+/* Convert a CLOCK_REALTIME timestamp from the kernel */
+uint64_t timestamp_ns( const timespec & ts )
+{
+  /* sample the offset between the two clocks now, so that
+     steps in the wall clock don't skew the result */
+  const uint64_t start = epoch();
+  const uint64_t monotonic_now = timestamp_ns_raw( current_time( CLOCK_MONOTONIC ) );
+  const uint64_t realtime_now = timestamp_ns_raw( current_time( CLOCK_REALTIME ) );
+
+  const uint64_t monotonic = timestamp_ns_raw( ts ) + monotonic_now - realtime_now;
+
+  /* don't let a timestamp from before the program started wrap around */
+  return monotonic > start ? monotonic - start : 0;
+}
+
+uint64_t timestamp_us( const timespec & ts )
+{
+  return timestamp_ns( ts ) / THOUSAND;
 }
 
 uint64_t timestamp_ms( const timespec & ts )
 {
-  const static uint64_t EPOCH = timestamp_ms_raw( current_time() );
-  return timestamp_ms_raw( ts ) - EPOCH;
+  return timestamp_ns( ts ) / MILLION;
 }
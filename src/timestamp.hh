@@ -4,8 +4,16 @@
 #include <ctime>
 #include <cstdint>
 
-/* Current time in milliseconds since the start of the program */
+/* Current time since the program first asked for a timestamp,
+   from the monotonic clock */
+uint64_t timestamp_ns();
+uint64_t timestamp_us();
 uint64_t timestamp_ms();
+
+/* Convert a CLOCK_REALTIME timestamp from the kernel (e.g. SO_TIMESTAMPNS)
+   to the same timeline as the functions above */
+uint64_t timestamp_ns( const timespec & ts );
+uint64_t timestamp_us( const timespec & ts );
 uint64_t timestamp_ms( const timespec & ts );
 
 #endif /* TIMESTAMP_HH */
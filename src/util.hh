@@ -3,8 +3,15 @@
 
 #include <system_error>
 #include <iostream>
+#include <limits>
+#include <new>
 #include <string>
+#include <cstdlib>
 #include <cstring>
+#include <type_traits>
+#include <utility>
+
+#include <sys/types.h>
 
 /* tagged_error: system_error + name of what was being attempted */
 class tagged_error : public std::system_error
@@ -58,6 +65,139 @@ inline int SystemCall( const std::string & s_attempt, const int return_value )
   return SystemCall( s_attempt.c_str(), return_value );
 }
 
+/* The outcome of a call that can fail without throwing: a value, or
+   the errno it failed with (for the caller to check, with no unwinding,
+   when failure is routine, as EAGAIN is on a nonblocking socket).
+   value() throws the unix_error that SystemCall() would have. */
+template <typename T>
+class Expected
+{
+private:
+  const char * attempt_;
+  int error_;
+  typename std::aligned_storage<sizeof( T ), alignof( T )>::type storage_;
+
+  T * pointer() { return reinterpret_cast<T *>( &storage_ ); }
+  const T * pointer() const { return reinterpret_cast<const T *>( &storage_ ); }
+
+  Expected( const char * s_attempt, const int s_error )
+    : attempt_( s_attempt ), error_( s_error ), storage_()
+  {}
+
+public:
+  Expected( T && s_value )
+    : attempt_( "" ), error_( 0 ), storage_()
+  {
+    new ( &storage_ ) T( std::move( s_value ) );
+  }
+
+  Expected( const T & s_value )
+    : attempt_( "" ), error_( 0 ), storage_()
+  {
+    new ( &storage_ ) T( s_value );
+  }
+
+  /* s_error must be nonzero */
+  static Expected failure( const char * s_attempt, const int s_error )
+  {
+    return Expected( s_attempt, s_error );
+  }
+
+  Expected( Expected && other )
+    : attempt_( other.attempt_ ), error_( other.error_ ), storage_()
+  {
+    if ( ok() ) {
+      new ( &storage_ ) T( std::move( *other.pointer() ) );
+    }
+  }
+
+  ~Expected()
+  {
+    if ( ok() ) {
+      pointer()->~T();
+    }
+  }
+
+  bool ok() const { return error_ == 0; }
+  explicit operator bool() const { return ok(); }
+  int error() const { return error_; }
+
+  /* did a nonblocking call fail only because it would have had to wait? */
+  bool would_block() const { return error_ == EAGAIN or error_ == EWOULDBLOCK; }
+
+  T & value()
+  {
+    if ( not ok() ) {
+      throw unix_error( attempt_, error_ );
+    }
+    return *pointer();
+  }
+
+  const T & value() const
+  {
+    if ( not ok() ) {
+      throw unix_error( attempt_, error_ );
+    }
+    return *pointer();
+  }
+
+  /* forbid copying or assigning */
+  Expected( const Expected & other ) = delete;
+  Expected & operator=( const Expected & other ) = delete;
+};
+
+/* version of SystemCall that reports failure in its result, instead of throwing */
+inline Expected<size_t> TrySystemCall( const char * s_attempt, const ssize_t return_value )
+{
+  if ( return_value >= 0 ) {
+    return Expected<size_t>( size_t( return_value ) );
+  }
+
+  return Expected<size_t>::failure( s_attempt, errno );
+}
+
+/* the digits (and, for a double, decimal point) of a number with
+   nothing else: no sign, space or trailing junk */
+inline bool parse_number_text( const std::string & text, unsigned long long & value )
+{
+  if ( text.empty() or text.find_first_not_of( "0123456789" ) != std::string::npos ) {
+    return false;
+  }
+
+  errno = 0;
+  value = strtoull( text.c_str(), nullptr, 10 );
+  return errno == 0;
+}
+
+inline bool parse_number_text( const std::string & text, double & value )
+{
+  if ( text.empty() or text.find_first_not_of( "0123456789." ) != std::string::npos ) {
+    return false;
+  }
+
+  char * end;
+  errno = 0;
+  value = strtod( text.c_str(), &end );
+  return errno == 0 and *end == '\0';
+}
+
+/* Parse a command-line value from min_value to max_value into value.
+   Unlike stoul() and friends, a bad value is false (for the caller to
+   print its usage), not an exception, and "-1" is not a huge number. */
+template <typename T>
+bool parse_number( const std::string & text, T & value,
+		   const T min_value, const T max_value = std::numeric_limits<T>::max() )
+{
+  typename std::conditional<std::is_floating_point<T>::value, double, unsigned long long>::type parsed;
+
+  if ( not parse_number_text( text, parsed ) or parsed < min_value or parsed > max_value ) {
+    return false;
+  }
+
+  value = parsed;
+  return true;
+}
+
 /* zero out an arbitrary structure */
 template <typename T> void zero( T & x ) { memset( &x, 0, sizeof( x ) ); }
 